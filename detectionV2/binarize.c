@@ -0,0 +1,149 @@
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+#include "binarize.h"
+#include "workers.h"
+#include "trace.h"
+
+#define SAUVOLA_R 128.0
+#define SAUVOLA_K 0.34
+#define SAUVOLA_MAX_RADIUS 127  // keeps a window sum of squares below 2^32
+#define SAUVOLA_ROWS 64         // rows per worker task
+
+int binarize_otsu_level(const GrayImage *g)
+{
+    guint64 hist[256] = {0};
+    gsize n = (gsize)g->w * (gsize)g->h;
+    for (gsize i = 0; i < n; i++) hist[g->data[i]]++;
+
+    double total = (double)n, sum_all = 0.0;
+    for (int i = 0; i < 256; i++) sum_all += (double)i * hist[i];
+
+    double w0 = 0.0, sum0 = 0.0, best = -1.0;
+    int level = 127;
+    for (int t = 0; t < 255; t++) {
+        w0 += hist[t];
+        sum0 += (double)t * hist[t];
+        if (w0 == 0.0) continue;
+        double w1 = total - w0;
+        if (w1 == 0.0) break;
+        double d = sum0 / w0 - (sum_all - sum0) / w1;
+        double between = w0 * w1 * d * d;
+        if (between > best) {
+            best = between;
+            level = t;
+        }
+    }
+    return level;
+}
+
+typedef struct
+{
+    const GrayImage *g;
+    BitImage *out;
+    const guint32 *sum, *sq;    // integral images, stride w + 1
+    int radius;
+    double k;
+} SauvolaJob;
+
+static void sauvola_rows(int task, void *ctx)
+{
+    const SauvolaJob *j = ctx;
+    int w = j->g->w, h = j->g->h, r = j->radius;
+    gsize stride = (gsize)w + 1;
+    int ya = task * SAUVOLA_ROWS;
+    int yb = MIN(ya + SAUVOLA_ROWS, h);
+
+    for (int y = ya; y < yb; y++) {
+        const guint8 *row = gray_row(j->g, y);
+        guint64 *bits = j->out->bits + (gsize)y * (gsize)j->out->words;
+        memset(bits, 0, sizeof(guint64) * j->out->words);
+
+        int y0 = MAX(y - r, 0), y1 = MIN(y + r, h - 1);
+        const guint32 *s_top = j->sum + (gsize)y0 * stride, *s_bot = j->sum + (gsize)(y1 + 1) * stride;
+        const guint32 *q_top = j->sq + (gsize)y0 * stride, *q_bot = j->sq + (gsize)(y1 + 1) * stride;
+        for (int x = 0; x < w; x++) {
+            int x0 = MAX(x - r, 0), x1 = MIN(x + r, w - 1);
+            double n = (double)(x1 - x0 + 1) * (y1 - y0 + 1);
+            // wrap-around differences are exact: the window sums fit in 32 bits
+            guint32 s = s_bot[x1 + 1] - s_bot[x0] - s_top[x1 + 1] + s_top[x0];
+            guint32 q = q_bot[x1 + 1] - q_bot[x0] - q_top[x1 + 1] + q_top[x0];
+            double m = s / n;
+            double var = q / n - m * m;
+            double dev = var > 0.0 ? sqrt(var) : 0.0;
+            double t = m * (1.0 + j->k * (dev / SAUVOLA_R - 1.0));
+            if (row[x] <= t) bits[x >> 6] |= (guint64)1 << (x & 63);
+        }
+    }
+}
+
+void binarize_sauvola(const GrayImage *g, BitImage *out, int radius, double k)
+{
+    int w = g->w, h = g->h;
+    radius = CLAMP(radius, 1, SAUVOLA_MAX_RADIUS);
+    bit_image_resize(out, w, h);
+
+    gsize stride = (gsize)w + 1;
+    gsize size = stride * ((gsize)h + 1);
+    guint32 *sum = g_malloc(size * sizeof(guint32));
+    guint32 *sq = g_malloc(size * sizeof(guint32));
+    memset(sum, 0, stride * sizeof(guint32));
+    memset(sq, 0, stride * sizeof(guint32));
+    for (int y = 0; y < h; y++) {
+        const guint8 *row = gray_row(g, y);
+        gsize up = (gsize)y * stride, cur = up + stride;
+        guint32 run = 0, run_sq = 0;
+        sum[cur] = sq[cur] = 0;
+        for (int x = 0; x < w; x++) {
+            run += row[x];
+            run_sq += (guint32)row[x] * row[x];
+            sum[cur + x + 1] = sum[up + x + 1] + run;
+            sq[cur + x + 1] = sq[up + x + 1] + run_sq;
+        }
+    }
+
+    SauvolaJob job = { g, out, sum, sq, radius, k };
+    workers_run((h + SAUVOLA_ROWS - 1) / SAUVOLA_ROWS, sauvola_rows, &job);
+
+    g_free(sum);
+    g_free(sq);
+}
+
+void binarize(const GrayImage *g, BinMethod method, BitImage *out)
+{
+    TRACE_SCOPE("binarize");
+    trace_count(TRACE_PIXELS, (gint64)g->w * g->h);
+    if (method == BIN_SAUVOLA) {
+        // about two letter heights on the example pages
+        int radius = MIN(g->w, g->h) / 20;
+        binarize_sauvola(g, out, MAX(radius, 7), SAUVOLA_K);
+        return;
+    }
+    bit_image_from_gray(out, g, (guint8)(binarize_otsu_level(g) + 1));
+}
+
+gboolean bin_method_from_string(const char *s, BinMethod *out)
+{
+    if (!s) return FALSE;
+    if (strcmp(s, "none") == 0) *out = BIN_NONE;
+    else if (strcmp(s, "otsu") == 0) *out = BIN_OTSU;
+    else if (strcmp(s, "sauvola") == 0) *out = BIN_SAUVOLA;
+    else return FALSE;
+    return TRUE;
+}
+
+const char *bin_method_name(BinMethod method)
+{
+    switch (method) {
+    case BIN_OTSU: return "otsu";
+    case BIN_SAUVOLA: return "sauvola";
+    default: return "none";
+    }
+}
+
+BinMethod bin_method_from_env(void)
+{
+    BinMethod m = BIN_NONE;
+    bin_method_from_string(g_getenv("OCR_BINARIZE"), &m);
+    return m;
+}
@@ -0,0 +1,32 @@
+#ifndef BINARIZE_H
+#define BINARIZE_H
+
+#include <glib.h>
+#include "grayimage.h"
+
+typedef enum
+{
+    BIN_NONE,            // no shared mask, each stage keeps its own threshold
+    BIN_OTSU,            // one global threshold from the histogram
+    BIN_SAUVOLA          // local threshold from the window mean and deviation
+} BinMethod;
+
+// Otsu threshold of the whole image: ink is gray <= the returned value.
+int binarize_otsu_level(const GrayImage *g);
+
+// Sauvola: ink where gray <= m * (1 + k * (s / 128 - 1)) over the
+// (2 radius + 1)^2 window around each pixel. Window sums come from integral
+// images of the gray values and their squares, so the cost does not depend
+// on the radius (capped at 127).
+void binarize_sauvola(const GrayImage *g, BitImage *out, int radius, double k);
+
+// Fills out with the ink mask of g. BIN_NONE is treated as Otsu.
+void binarize(const GrayImage *g, BinMethod method, BitImage *out);
+
+// "otsu", "sauvola" or "none". Returns FALSE for anything else.
+gboolean bin_method_from_string(const char *s, BinMethod *out);
+const char *bin_method_name(BinMethod method);
+// OCR_BINARIZE environment variable, BIN_NONE when unset or unknown.
+BinMethod bin_method_from_env(void);
+
+#endif
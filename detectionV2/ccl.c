@@ -0,0 +1,182 @@
+#include <glib.h>
+#include <string.h>
+#include "ccl.h"
+#include "trace.h"
+
+void ccl_init(CclLabeler *L)
+{
+    memset(L, 0, sizeof(*L));
+}
+
+void ccl_free(CclLabeler *L)
+{
+    g_free(L->labels);
+    g_free(L->mask);
+    g_free(L->parent);
+    g_free(L->remap);
+    g_free(L->order);
+    g_free(L->sums);
+    g_free(L->comps);
+    memset(L, 0, sizeof(*L));
+}
+
+static void free_thread_labeler(gpointer p)
+{
+    ccl_free(p);
+    g_free(p);
+}
+
+CclLabeler *ccl_thread_labeler(void)
+{
+    static GPrivate key = G_PRIVATE_INIT(free_thread_labeler);
+    CclLabeler *L = g_private_get(&key);
+    if (!L) {
+        L = g_malloc(sizeof(*L));
+        ccl_init(L);
+        g_private_set(&key, L);
+    }
+    return L;
+}
+
+// grows *buf to hold n elements of size sz; old contents are not kept
+static void reserve(void **buf, gsize *cap, gsize n, gsize sz)
+{
+    if (n <= *cap) return;
+    gsize c = *cap ? *cap : 256;
+    while (c < n) c *= 2;
+    g_free(*buf);
+    *buf = g_malloc(c * sz);
+    *cap = c;
+}
+
+guint8 *ccl_mask(CclLabeler *L, int w, int h)
+{
+    reserve((void **)&L->mask, &L->mask_cap, (gsize)w * (gsize)h, 1);
+    return L->mask;
+}
+
+static inline guint32 find_root(guint32 *parent, guint32 a)
+{
+    while (parent[a] != a) {
+        parent[a] = parent[parent[a]];
+        a = parent[a];
+    }
+    return a;
+}
+
+static inline guint32 unite(guint32 *parent, guint32 a, guint32 b)
+{
+    a = find_root(parent, a);
+    b = find_root(parent, b);
+    if (a < b) { parent[b] = a; return a; }
+    parent[a] = b;
+    return b;
+}
+
+int ccl_label(CclLabeler *L, const guint8 *mask, int w, int h, int stride)
+{
+    gsize npix = (gsize)w * (gsize)h;
+    L->w = w;
+    L->h = h;
+    L->count = 0;
+    if (w <= 0 || h <= 0) return 0;
+
+    reserve((void **)&L->labels, &L->labels_cap, npix, sizeof(guint32));
+    // 4-connectivity: at most one new provisional label per two pixels
+    reserve((void **)&L->parent, &L->parent_cap, npix / 2 + 2, sizeof(guint32));
+    guint32 *lab = L->labels;
+    guint32 *parent = L->parent;
+    guint32 next = 1;
+    parent[0] = 0;
+
+    // Pass 1: provisional labels from the left and upper neighbours
+    for (int y = 0; y < h; y++) {
+        const guint8 *m = mask + (gsize)y * (gsize)stride;
+        guint32 *row = lab + (gsize)y * (gsize)w;
+        const guint32 *up = y > 0 ? row - w : NULL;
+        for (int x = 0; x < w; x++) {
+            if (!m[x]) { row[x] = 0; continue; }
+            guint32 l = x > 0 ? row[x - 1] : 0;
+            guint32 u = up ? up[x] : 0;
+            if (l && u) row[x] = (l == u) ? l : unite(parent, l, u);
+            else if (l || u) row[x] = l | u;
+            else {
+                parent[next] = next;
+                row[x] = next++;
+            }
+        }
+    }
+
+    // Pass 2: final labels in raster order of first pixel, plus stats
+    gsize nprov = next;
+    reserve((void **)&L->remap, &L->remap_cap, nprov, sizeof(guint32));
+    reserve((void **)&L->comps, &L->comps_cap, nprov, sizeof(CclComponent));
+    reserve((void **)&L->sums, &L->sums_cap, 2 * nprov, sizeof(gint64));
+    guint32 *remap = L->remap;
+    memset(remap, 0, nprov * sizeof(guint32));
+    CclComponent *comps = L->comps;
+    gint64 *sums = L->sums;
+    int count = 0;
+
+    for (int y = 0; y < h; y++) {
+        guint32 *row = lab + (gsize)y * (gsize)w;
+        for (int x = 0; x < w; x++) {
+            guint32 p = row[x];
+            if (!p) continue;
+            guint32 r = find_root(parent, p);
+            if (!remap[r]) {
+                remap[r] = (guint32)++count;
+                CclComponent *c = &comps[count - 1];
+                c->area = 0;
+                c->min_x = c->max_x = c->seed_x = x;
+                c->min_y = c->max_y = c->seed_y = y;
+                sums[2 * (count - 1)] = 0;
+                sums[2 * (count - 1) + 1] = 0;
+            }
+            guint32 f = remap[r];
+            row[x] = f;
+
+            CclComponent *c = &comps[f - 1];
+            c->area++;
+            if (x < c->min_x) c->min_x = x;
+            if (x > c->max_x) c->max_x = x;
+            if (y > c->max_y) c->max_y = y;
+            sums[2 * (f - 1)] += x;
+            sums[2 * (f - 1) + 1] += y;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        comps[i].cx = (double)sums[2 * i] / comps[i].area;
+        comps[i].cy = (double)sums[2 * i + 1] / comps[i].area;
+    }
+    L->count = count;
+    trace_count(TRACE_COMPONENTS, count);
+    return count;
+}
+
+int ccl_order_in_rect(CclLabeler *L, int x0, int y0, int x1, int y1)
+{
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > L->w - 1) x1 = L->w - 1;
+    if (y1 > L->h - 1) y1 = L->h - 1;
+    if (L->count == 0 || x0 > x1 || y0 > y1) return 0;
+
+    // remap is free after labeling; reuse it as the "already listed" flags
+    reserve((void **)&L->order, &L->order_cap, (gsize)L->count, sizeof(int));
+    guint32 *seen = L->remap;
+    memset(seen, 0, ((gsize)L->count + 1) * sizeof(guint32));
+    int n = 0;
+
+    for (int y = y0; y <= y1; y++) {
+        const guint32 *row = L->labels + (gsize)y * (gsize)L->w;
+        for (int x = x0; x <= x1; x++) {
+            guint32 f = row[x];
+            if (!f || seen[f]) continue;
+            seen[f] = 1;
+            L->order[n++] = (int)f - 1;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,49 @@
+#ifndef CCL_H
+#define CCL_H
+
+#include <glib.h>
+
+// Connected component labeling (4-connectivity, two-pass union-find).
+// A labeler keeps its buffers between calls and only grows them.
+
+typedef struct
+{
+    int area;
+    int min_x, min_y, max_x, max_y;
+    double cx, cy;       // centroid
+    int seed_x, seed_y;  // first pixel in raster order
+} CclComponent;
+
+typedef struct
+{
+    int w, h;
+    guint32 *labels;     // w*h, 0 = background, else component index + 1
+    int count;
+    CclComponent *comps; // ordered by first pixel in raster order
+
+    guint8 *mask;        // scratch mask handed out by ccl_mask()
+    guint32 *parent;     // provisional label forest
+    guint32 *remap;      // provisional root -> final label
+    int *order;          // filled by ccl_order_in_rect()
+    gint64 *sums;        // 2 per component (x, y)
+    gsize labels_cap, mask_cap, parent_cap, remap_cap, comps_cap, sums_cap, order_cap;
+} CclLabeler;
+
+void ccl_init(CclLabeler *L);
+void ccl_free(CclLabeler *L);
+
+// Per-thread labeler, freed when the thread exits.
+CclLabeler *ccl_thread_labeler(void);
+
+// Reusable w*h byte buffer for callers that build the mask themselves.
+guint8 *ccl_mask(CclLabeler *L, int w, int h);
+
+// mask: nonzero = foreground, rows of `stride` bytes. Returns the count.
+int ccl_label(CclLabeler *L, const guint8 *mask, int w, int h, int stride);
+
+// Components with at least one pixel in [x0..x1]x[y0..y1], in the order a
+// raster scan of that rectangle first meets them. Returns how many are in
+// L->order (component indices).
+int ccl_order_in_rect(CclLabeler *L, int x0, int y0, int x1, int y1);
+
+#endif
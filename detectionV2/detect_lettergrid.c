@@ -9,15 +9,14 @@
 #include <unistd.h>
 #include <dirent.h>
 #include <errno.h>
+#include "glyphs.h"
+#include "trace.h"
+#include "ccl.h"
+#include "grayimage.h"
 
 #define LETTER_TARGET_W 48
 #define LETTER_TARGET_H 48
 
-#define MAX_GRID_COLS 64
-#define MAX_GRID_ROWS 64
-
-typedef struct { int x, y; } Point;
-
 typedef struct
 {
     int min_x, max_x;
@@ -32,29 +31,6 @@ static inline int clampi(int v, int lo, int hi)
     return v < lo ? lo : (v > hi ? hi : v);
 }
 
-static int ensure_dir(const char *path)
-{
-    struct stat st;
-    if (stat(path, &st) == 0)
-        return S_ISDIR(st.st_mode) ? 0 : -1;
-    return mkdir(path, 0755);
-}
-
-static inline guint8 get_gray(GdkPixbuf *pix, int x, int y)
-{
-    int W = gdk_pixbuf_get_width(pix);
-    int H = gdk_pixbuf_get_height(pix);
-
-    x = clampi(x, 0, W - 1);
-    y = clampi(y, 0, H - 1);
-
-    int n  = gdk_pixbuf_get_n_channels(pix);
-    int rs = gdk_pixbuf_get_rowstride(pix);
-    guchar *p = gdk_pixbuf_get_pixels(pix) + y * rs + x * n;
-
-    return (guint8)((p[0] + p[1] + p[2]) / 3);
-}
-
 static void put_rgb(GdkPixbuf *pix, int x, int y, guint8 R, guint8 G, guint8 B)
 {
     int W = gdk_pixbuf_get_width(pix);
@@ -100,132 +76,38 @@ static void draw_rect_thick(GdkPixbuf *pix, int x0, int y0, int x1, int y1,
     }
 }
 
-static int parse_cell_filename(const char *name, int *col, int *row, int *idx)
-{
-    int c, r, i;
-    if (sscanf(name, "%d_%d_%d.png", &c, &r, &i) == 3)
-    {
-        *col = c; *row = r; *idx = i;
-        return 1;
-    }
-    return 0;
-}
-
-static void cleanup_cells_dir(const char *dirpath, int max_cols, int max_rows)
+// Keeps, for each grid cell, the glyph detected last and drops the
+// glyphs that fall outside max_cols x max_rows.
+static void keep_last_glyph_per_cell(GlyphBuffer *buf, int start, int max_cols, int max_rows)
 {
-    int best_idx[65][65];
-    char best_name[65][65][256];
-
-    for (int c = 0; c < 65; ++c)
-        for (int r = 0; r < 65; ++r)
-        {
-            best_idx[c][r] = -1;
-            best_name[c][r][0] = '\0';
-        }
-
-    DIR *d = opendir(dirpath);
-    if (!d) return;
+    int *best = g_malloc((gsize)(max_cols + 1) * (gsize)(max_rows + 1) * sizeof(int));
+    for (int i = 0; i < (max_cols + 1) * (max_rows + 1); ++i) best[i] = -1;
 
-    struct dirent *de;
-    while ((de = readdir(d)) != NULL)
+    for (int i = start; i < buf->len; ++i)
     {
-        if (de->d_name[0] == '.') continue;
-
-        int col, row, idx;
-        if (!parse_cell_filename(de->d_name, &col, &row, &idx))
-            continue;
-
-        if (col < 1 || col > max_cols || row < 1 || row > max_rows)
+        const Glyph *g = &buf->items[i];
+        if (g->col < 1 || g->col > max_cols || g->row < 1 || g->row > max_rows)
             continue;
 
-        if (idx > best_idx[col][row])
-        {
-            best_idx[col][row] = idx;
-            snprintf(best_name[col][row], sizeof(best_name[col][row]), "%s", de->d_name);
-        }
+        int *slot = &best[g->row * (max_cols + 1) + g->col];
+        if (*slot < 0 || g->idx > buf->items[*slot].idx)
+            *slot = i;
     }
-    closedir(d);
-
-    d = opendir(dirpath);
-    if (!d) return;
 
-    while ((de = readdir(d)) != NULL)
+    int out = start;
+    for (int i = start; i < buf->len; ++i)
     {
-        if (de->d_name[0] == '.') continue;
-
-        int col, row, idx;
-        if (!parse_cell_filename(de->d_name, &col, &row, &idx))
-            continue;
-
-        char fullpath[512];
-        snprintf(fullpath, sizeof(fullpath), "%s/%s", dirpath, de->d_name);
-
-        if (col < 1 || col > max_cols || row < 1 || row > max_rows)
-        {
-            (void)unlink(fullpath);
+        const Glyph *g = &buf->items[i];
+        if (g->col < 1 || g->col > max_cols || g->row < 1 || g->row > max_rows)
             continue;
-        }
-
-        if (best_idx[col][row] < 0 || strcmp(de->d_name, best_name[col][row]) != 0)
-        {
-            (void)unlink(fullpath);
+        if (best[g->row * (max_cols + 1) + g->col] != i)
             continue;
-        }
+        if (out != i) buf->items[out] = buf->items[i];
+        out++;
     }
+    buf->len = out;
 
-    closedir(d);
-}
-
-static inline gboolean is_black_pixel(GdkPixbuf *img, int x, int y, guint8 thr)
-{
-    int W = gdk_pixbuf_get_width(img);
-    int H = gdk_pixbuf_get_height(img);
-    if (x < 0 || x >= W || y < 0 || y >= H) return FALSE;
-    return get_gray(img, x, y) < thr;
-}
-
-static void flood_fill_component(GdkPixbuf *img, guint8 thr, int sx, int sy,
-                                 int *min_x, int *max_x,
-                                 int *min_y, int *max_y,
-                                 gboolean **visited, int W, int H)
-{
-    Point *stack = g_malloc((gsize)W * (gsize)H * sizeof(Point));
-    if (!stack) return;
-
-    int top = 0;
-    stack[top++] = (Point){ sx, sy };
-    visited[sy][sx] = TRUE;
-
-    *min_x = sx; *max_x = sx;
-    *min_y = sy; *max_y = sy;
-
-    static const int dx[4] = { -1, 1, 0, 0 };
-    static const int dy[4] = { 0, 0, -1, 1 };
-
-    while (top > 0)
-    {
-        Point p = stack[--top];
-
-        if (p.x < *min_x) *min_x = p.x;
-        if (p.x > *max_x) *max_x = p.x;
-        if (p.y < *min_y) *min_y = p.y;
-        if (p.y > *max_y) *max_y = p.y;
-
-        for (int k = 0; k < 4; ++k)
-        {
-            int nx = p.x + dx[k];
-            int ny = p.y + dy[k];
-
-            if (nx >= 0 && nx < W && ny >= 0 && ny < H &&
-                !visited[ny][nx] && is_black_pixel(img, nx, ny, thr))
-            {
-                visited[ny][nx] = TRUE;
-                stack[top++] = (Point){ nx, ny };
-            }
-        }
-    }
-
-    g_free(stack);
+    g_free(best);
 }
 
 static void binarize_pixbuf(GdkPixbuf *pix, guint8 thr)
@@ -299,82 +181,37 @@ static void remove_small_components_binary(GdkPixbuf *pix, int min_area)
     int n  = gdk_pixbuf_get_n_channels(pix);
     guchar *p = gdk_pixbuf_get_pixels(pix);
 
-    guint8 *vis = (guint8*)g_malloc0((gsize)W * (gsize)H);
-    if (!vis) return;
+    CclLabeler *L = ccl_thread_labeler();
+    guint8 *mask = ccl_mask(L, W, H);
+    for (int y = 0; y < H; ++y)
+        for (int x = 0; x < W; ++x)
+            mask[y * W + x] = p[y * rs + x * n] == 0;
 
-    Point *q = (Point*)g_malloc((gsize)W * (gsize)H * sizeof(Point));
-    if (!q) { g_free(vis); return; }
+    if (ccl_label(L, mask, W, H, W) == 0) return;
 
-    for (int y0 = 0; y0 < H; ++y0)
+    for (int y = 0; y < H; ++y)
     {
-        for (int x0 = 0; x0 < W; ++x0)
+        for (int x = 0; x < W; ++x)
         {
-            size_t idx0 = (size_t)y0 * (size_t)W + (size_t)x0;
-            if (vis[idx0]) continue;
-
-            guchar *px0 = p + y0 * rs + x0 * n;
-            if (px0[0] != 0) { vis[idx0] = 1; continue; }
-
-            int head = 0, tail = 0;
-            q[tail++] = (Point){x0, y0};
-            vis[idx0] = 1;
-
-            int area = 0;
-            while (head < tail)
-            {
-                Point cur = q[head++];
-                area++;
-
-                static const int dx[4] = { -1, 1, 0, 0 };
-                static const int dy[4] = { 0, 0, -1, 1 };
-
-                for (int k = 0; k < 4; ++k)
-                {
-                    int nx = cur.x + dx[k];
-                    int ny = cur.y + dy[k];
-                    if (nx < 0 || nx >= W || ny < 0 || ny >= H) continue;
-
-                    size_t idn = (size_t)ny * (size_t)W + (size_t)nx;
-                    if (vis[idn]) continue;
-
-                    guchar *pxn = p + ny * rs + nx * n;
-                    if (pxn[0] == 0)
-                    {
-                        vis[idn] = 1;
-                        q[tail++] = (Point){nx, ny};
-                    }
-                    else
-                    {
-                        vis[idn] = 1;
-                    }
-                }
-            }
-
-            if (area < min_area)
-            {
-                for (int i = 0; i < tail; ++i)
-                {
-                    int x = q[i].x, y = q[i].y;
-                    guchar *px = p + y * rs + x * n;
-                    px[0] = px[1] = px[2] = 255;
-                }
-            }
+            guint32 f = L->labels[y * W + x];
+            if (!f || L->comps[f - 1].area >= min_area) continue;
+            guchar *px = p + y * rs + x * n;
+            px[0] = px[1] = px[2] = 255;
         }
     }
-
-    g_free(q);
-    g_free(vis);
 }
 
-static void clean_letter_pixbuf(GdkPixbuf *pix)
+// Tiles cut from a binary page are already 1-bit: only the despeckling runs.
+static void clean_letter_pixbuf(GdkPixbuf *pix, gboolean binary)
 {
-    binarize_pixbuf(pix, 180);
+    if (!binary) binarize_pixbuf(pix, 180);
     despeckle_by_neighbors(pix, 2);
     remove_small_components_binary(pix, 6);
     despeckle_by_neighbors(pix, 2);
 }
 
-static int save_letter_simple(GdkPixbuf *img, GdkPixbuf *disp,
+static int save_letter_simple(GdkPixbuf *img, const GrayImage *gray,
+                              GdkPixbuf *disp, GlyphBuffer *out,
                               int min_x, int min_y, int max_x, int max_y,
                               guint8 R, guint8 G, guint8 B,
                               int col_idx, int row_idx, int letter_idx,
@@ -394,48 +231,37 @@ static int save_letter_simple(GdkPixbuf *img, GdkPixbuf *disp,
 
     draw_rect_thick(disp, x0, y0, x1, y1, R, G, B, 1);
 
-    GdkPixbuf *sub = gdk_pixbuf_new_subpixbuf(img, x0, y0, w, h);
-    if (!sub) return letter_idx;
-
-    GdkPixbuf *scaled = gdk_pixbuf_scale_simple(sub, LETTER_TARGET_W, LETTER_TARGET_H, GDK_INTERP_BILINEAR);
-    g_object_unref(sub);
+    GdkPixbuf *scaled;
+    if (gray->binary)
+    {
+        scaled = gray_crop_scaled(gray, x0, y0, w, h, LETTER_TARGET_W, LETTER_TARGET_H);
+    }
+    else
+    {
+        GdkPixbuf *sub = gdk_pixbuf_new_subpixbuf(img, x0, y0, w, h);
+        if (!sub) return letter_idx;
+        scaled = gdk_pixbuf_scale_simple(sub, LETTER_TARGET_W, LETTER_TARGET_H, GDK_INTERP_BILINEAR);
+        g_object_unref(sub);
+    }
     if (!scaled) return letter_idx;
 
-    clean_letter_pixbuf(scaled);
+    clean_letter_pixbuf(scaled, gray->binary);
 
-    char path[512];
-    snprintf(path, sizeof(path), "cells/%03d_%03d_%04d.png", col_idx, row_idx, letter_idx);
-    (void)gdk_pixbuf_save(scaled, path, "png", NULL, NULL);
+    Glyph *g = glyph_buffer_push(out, scaled);
+    if (g) { g->col = col_idx; g->row = row_idx; g->idx = letter_idx; }
 
     g_object_unref(scaled);
     return letter_idx + 1;
 }
 
-static int save_letter_normalized(GdkPixbuf *img, GdkPixbuf *disp,
-                                  int min_x, int min_y, int max_x, int max_y,
-                                  guint8 R, guint8 G, guint8 B,
-                                  int col_idx, int row_idx, int letter_idx,
-                                  int margin)
+// Bilinear scale of the box of img onto a white LETTER_TARGET_W x LETTER_TARGET_H tile.
+static GdkPixbuf *scale_letter(GdkPixbuf *img, int x0, int y0, int src_w, int src_h)
 {
-    int W = gdk_pixbuf_get_width(img);
-    int H = gdk_pixbuf_get_height(img);
-
-    int x0 = clampi(min_x - margin, 0, W - 1);
-    int y0 = clampi(min_y - margin, 0, H - 1);
-    int x1 = clampi(max_x + margin, 0, W - 1);
-    int y1 = clampi(max_y + margin, 0, H - 1);
-
-    int src_w = x1 - x0 + 1;
-    int src_h = y1 - y0 + 1;
-    if (src_w <= 0 || src_h <= 0) return letter_idx;
-
-    draw_rect_thick(disp, x0, y0, x1, y1, R, G, B, 1);
-
     GdkPixbuf *sub = gdk_pixbuf_new_subpixbuf(img, x0, y0, src_w, src_h);
-    if (!sub) return letter_idx;
+    if (!sub) return NULL;
 
     GdkPixbuf *out = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, LETTER_TARGET_W, LETTER_TARGET_H);
-    if (!out) { g_object_unref(sub); return letter_idx; }
+    if (!out) { g_object_unref(sub); return NULL; }
 
     int out_rs = gdk_pixbuf_get_rowstride(out);
     int out_n  = gdk_pixbuf_get_n_channels(out);
@@ -457,8 +283,38 @@ static int save_letter_normalized(GdkPixbuf *img, GdkPixbuf *disp,
     gdk_pixbuf_scale(sub, out, 0, 0, LETTER_TARGET_W, LETTER_TARGET_H,
                      0.0, 0.0, sx, sy, GDK_INTERP_BILINEAR);
     g_object_unref(sub);
+    return out;
+}
+
+static int save_letter_normalized(GdkPixbuf *img, const GrayImage *gray,
+                                  GdkPixbuf *disp, GlyphBuffer *glyphs,
+                                  int min_x, int min_y, int max_x, int max_y,
+                                  guint8 R, guint8 G, guint8 B,
+                                  int col_idx, int row_idx, int letter_idx,
+                                  int margin)
+{
+    int W = gdk_pixbuf_get_width(img);
+    int H = gdk_pixbuf_get_height(img);
 
-    clean_letter_pixbuf(out);
+    int x0 = clampi(min_x - margin, 0, W - 1);
+    int y0 = clampi(min_y - margin, 0, H - 1);
+    int x1 = clampi(max_x + margin, 0, W - 1);
+    int y1 = clampi(max_y + margin, 0, H - 1);
+
+    int src_w = x1 - x0 + 1;
+    int src_h = y1 - y0 + 1;
+    if (src_w <= 0 || src_h <= 0) return letter_idx;
+
+    draw_rect_thick(disp, x0, y0, x1, y1, R, G, B, 1);
+
+    GdkPixbuf *out;
+    if (gray->binary)
+        out = gray_crop_scaled(gray, x0, y0, src_w, src_h, LETTER_TARGET_W, LETTER_TARGET_H);
+    else
+        out = scale_letter(img, x0, y0, src_w, src_h);
+    if (!out) return letter_idx;
+
+    clean_letter_pixbuf(out, gray->binary);
 
     int rs  = gdk_pixbuf_get_rowstride(out);
     int nch = gdk_pixbuf_get_n_channels(out);
@@ -482,9 +338,8 @@ static int save_letter_normalized(GdkPixbuf *img, GdkPixbuf *disp,
         return letter_idx;
     }
 
-    char path[512];
-    snprintf(path, sizeof(path), "cells/%03d_%03d_%04d.png", col_idx, row_idx, letter_idx);
-    (void)gdk_pixbuf_save(out, path, "png", NULL, NULL);
+    Glyph *g = glyph_buffer_push(glyphs, out);
+    if (g) { g->col = col_idx; g->row = row_idx; g->idx = letter_idx; }
 
     g_object_unref(out);
     return letter_idx + 1;
@@ -538,15 +393,16 @@ static int cmp_cx(const void *a, const void *b)
     return (cxA > cxB) - (cxA < cxB);
 }
 
-static int detect_letters_by_cells(GdkPixbuf *img, GdkPixbuf *disp,
+static int detect_letters_by_cells(GdkPixbuf *img, const GrayImage *gray,
+                                   GdkPixbuf *disp, GlyphBuffer *out,
                                    int gx0, int gx1, int gy0, int gy1,
                                    guint8 R, guint8 G, guint8 B,
                                    int *out_nb_cells)
 {
     if (out_nb_cells) *out_nb_cells = 0;
 
-    int W = gdk_pixbuf_get_width(img);
-    int H = gdk_pixbuf_get_height(img);
+    int W = gray->w;
+    int H = gray->h;
 
     const guint8 GRID_THR   = 120;
     const guint8 LETTER_THR = 170;
@@ -565,27 +421,15 @@ static int detect_letters_by_cells(GdkPixbuf *img, GdkPixbuf *disp,
         return 0;
     }
 
+    gray_ink_profiles(gray, GRID_THR, gx0, gx1, gy0, gy1, col_sum, row_sum);
+
     int max_col_sum = 0;
-    for (int x = gx0; x <= gx1; ++x)
-    {
-        int idx = x - gx0;
-        int cnt = 0;
-        for (int y = gy0; y <= gy1; ++y)
-            if (get_gray(img, x, y) < GRID_THR) cnt++;
-        col_sum[idx] = cnt;
-        if (cnt > max_col_sum) max_col_sum = cnt;
-    }
+    for (int i = 0; i < grid_w; ++i)
+        if (col_sum[i] > max_col_sum) max_col_sum = col_sum[i];
 
     int max_row_sum = 0;
-    for (int y = gy0; y <= gy1; ++y)
-    {
-        int idx = y - gy0;
-        int cnt = 0;
-        for (int x = gx0; x <= gx1; ++x)
-            if (get_gray(img, x, y) < GRID_THR) cnt++;
-        row_sum[idx] = cnt;
-        if (cnt > max_row_sum) max_row_sum = cnt;
-    }
+    for (int i = 0; i < grid_h; ++i)
+        if (row_sum[i] > max_row_sum) max_row_sum = row_sum[i];
 
     if (max_col_sum == 0 || max_row_sum == 0)
     {
@@ -667,9 +511,10 @@ static int detect_letters_by_cells(GdkPixbuf *img, GdkPixbuf *disp,
 
             for (int y = cy0; y <= cy1; ++y)
             {
+                const guint8 *row = gray_row(gray, y);
                 for (int x = cx0; x <= cx1; ++x)
                 {
-                    if (is_black_pixel(img, x, y, LETTER_THR))
+                    if (row[x] < LETTER_THR)
                     {
                         if (x < min_x) min_x = x;
                         if (x > max_x) max_x = x;
@@ -686,7 +531,7 @@ static int detect_letters_by_cells(GdkPixbuf *img, GdkPixbuf *disp,
             int col_idx = c + 1;
             int row_idx = r + 1;
 
-            letter_idx = save_letter_simple(img, disp,
+            letter_idx = save_letter_simple(img, gray, disp, out,
                                             min_x, min_y, max_x, max_y,
                                             R, G, B,
                                             col_idx, row_idx,
@@ -700,12 +545,18 @@ static int detect_letters_by_cells(GdkPixbuf *img, GdkPixbuf *disp,
     return letter_idx;
 }
 
-static void detect_letters_legacy(GdkPixbuf *img, GdkPixbuf *disp,
+// *max_cols / *max_rows receive the size of the grid the glyphs were placed
+// in: the cells between the detected lines, or the rows and columns of
+// letters when no line was found.
+static void detect_letters_legacy(GdkPixbuf *img, const GrayImage *gray,
+                                  GdkPixbuf *disp, GlyphBuffer *out,
                                   int gx0, int gx1, int gy0, int gy1,
-                                  guint8 R, guint8 G, guint8 B)
+                                  guint8 R, guint8 G, guint8 B,
+                                  int *max_cols, int *max_rows)
 {
-    int W = gdk_pixbuf_get_width(img);
-    int H = gdk_pixbuf_get_height(img);
+    *max_cols = *max_rows = 0;
+    int W = gray->w;
+    int H = gray->h;
 
     const int    MIN_AREA        = 3;
     const int    MIN_WIDTH       = 1;
@@ -727,9 +578,6 @@ static void detect_letters_legacy(GdkPixbuf *img, GdkPixbuf *disp,
     int grid_h = gy1 - gy0 + 1;
     if (grid_w <= 0 || grid_h <= 0) return;
 
-    GdkPixbuf *work = gdk_pixbuf_copy(img);
-    if (!work) return;
-
     int      *col_sum  = g_malloc0((gsize)grid_w * sizeof(int));
     int      *row_sum  = g_malloc0((gsize)grid_h * sizeof(int));
     gboolean *is_vline = g_malloc0((gsize)W * sizeof(gboolean));
@@ -737,27 +585,10 @@ static void detect_letters_legacy(GdkPixbuf *img, GdkPixbuf *disp,
     if (!col_sum || !row_sum || !is_vline || !is_hline)
     {
         g_free(col_sum); g_free(row_sum); g_free(is_vline); g_free(is_hline);
-        g_object_unref(work);
         return;
     }
 
-    for (int x = gx0; x <= gx1; ++x)
-    {
-        int idx_x = x - gx0;
-        int cnt = 0;
-        for (int y = gy0; y <= gy1; ++y)
-            if (get_gray(img, x, y) < GRID_BLACK_THR) cnt++;
-        col_sum[idx_x] = cnt;
-    }
-
-    for (int y = gy0; y <= gy1; ++y)
-    {
-        int idx_y = y - gy0;
-        int cnt = 0;
-        for (int x = gx0; x <= gx1; ++x)
-            if (get_gray(img, x, y) < GRID_BLACK_THR) cnt++;
-        row_sum[idx_y] = cnt;
-    }
+    gray_ink_profiles(gray, GRID_BLACK_THR, gx0, gx1, gy0, gy1, col_sum, row_sum);
 
     double COL_DENSITY_THR = 0.70;
     double ROW_DENSITY_THR = 0.70;
@@ -766,122 +597,112 @@ static void detect_letters_legacy(GdkPixbuf *img, GdkPixbuf *disp,
     {
         int idx_x = x - gx0;
         if (col_sum[idx_x] >= (int)(COL_DENSITY_THR * (double)grid_h))
-        {
             is_vline[x] = TRUE;
-            for (int y = gy0; y <= gy1; ++y) put_rgb(work, x, y, 255, 255, 255);
-        }
     }
 
     for (int y = gy0; y <= gy1; ++y)
     {
         int idx_y = y - gy0;
         if (row_sum[idx_y] >= (int)(ROW_DENSITY_THR * (double)grid_w))
-        {
             is_hline[y] = TRUE;
-            for (int x = gx0; x <= gx1; ++x) put_rgb(work, x, y, 255, 255, 255);
-        }
     }
 
     g_free(col_sum);
     g_free(row_sum);
 
-    int vx[512], vy[512];
-    int nv = extract_line_centers(is_vline, gx0, gx1, vx, 512);
-    int nh = extract_line_centers(is_hline, gy0, gy1, vy, 512);
-
-    gboolean **visited = g_malloc((gsize)H * sizeof(gboolean *));
-    if (!visited)
+    // One center at most per scanned column/row, so no cap on the grid size.
+    int max_lines_x = gx1 - gx0 + 8;
+    int max_lines_y = gy1 - gy0 + 8;
+    int *vx = g_malloc((gsize)max_lines_x * sizeof(int));
+    int *vy = g_malloc((gsize)max_lines_y * sizeof(int));
+    int nv = extract_line_centers(is_vline, gx0, gx1, vx, max_lines_x);
+    int nh = extract_line_centers(is_hline, gy0, gy1, vy, max_lines_y);
+    if (nv >= 2 && nh >= 2)
     {
-        g_free(is_vline); g_free(is_hline);
-        g_object_unref(work);
-        return;
+        *max_cols = nv - 1;
+        *max_rows = nh - 1;
     }
+
+    // Letter components with the grid lines erased, in the order a raster
+    // scan of the grid meets them (components may extend outside the grid box).
+    CclLabeler *ccl = ccl_thread_labeler();
+    guint8 *mask = ccl_mask(ccl, W, H);
     for (int y = 0; y < H; ++y)
     {
-        visited[y] = g_malloc0((gsize)W * sizeof(gboolean));
-        if (!visited[y])
-        {
-            for (int yy = 0; yy < y; ++yy) g_free(visited[yy]);
-            g_free(visited);
-            g_free(is_vline); g_free(is_hline);
-            g_object_unref(work);
-            return;
-        }
+        const guint8 *row = gray_row(gray, y);
+        guint8 *m = mask + (gsize)y * (gsize)W;
+        for (int x = 0; x < W; ++x) m[x] = row[x] < LETTER_BLACK_THR;
+
+        if (y < gy0 || y > gy1) continue;
+        if (is_hline[y])
+            memset(m + gx0, 0, (size_t)(gx1 - gx0 + 1));
+        else
+            for (int x = gx0; x <= gx1; ++x) if (is_vline[x]) m[x] = 0;
     }
+    ccl_label(ccl, mask, W, H, W);
+    int ncomp = ccl_order_in_rect(ccl, gx0, gy0, gx1, gy1);
 
     GArray *cands = g_array_new(FALSE, FALSE, sizeof(LetterCand));
 
-    for (int y = gy0; y <= gy1; ++y)
+    for (int ci = 0; ci < ncomp; ++ci)
     {
-        for (int x = gx0; x <= gx1; ++x)
-        {
-            if (!is_black_pixel(work, x, y, LETTER_BLACK_THR) || visited[y][x]) continue;
-
-            int min_x = x, max_x = x, min_y = y, max_y = y;
-
-flood_fill_component(work, LETTER_BLACK_THR, x, y,
-                     &min_x, &max_x, &min_y, &max_y,
-                     visited, W, H);
-
-
-if (min_x > max_x || min_y > max_y)
-    continue;
-
-int width  = max_x - min_x + 1;
-int height = max_y - min_y + 1;
-int area   = width * height;
+        const CclComponent *comp = &ccl->comps[ccl->order[ci]];
+        int min_x = comp->min_x, max_x = comp->max_x;
+        int min_y = comp->min_y, max_y = comp->max_y;
 
+        int width  = max_x - min_x + 1;
+        int height = max_y - min_y + 1;
+        int area   = width * height;
 
-            if (width <= 6 && height <= 6 && area <= 40) continue;
-            if (area < MIN_AREA) continue;
-            if (area > MAX_AREA_ABS) continue;
-            if (width > MAX_W_ABS || height > MAX_H_ABS) continue;
+        if (width <= 6 && height <= 6 && area <= 40) continue;
+        if (area < MIN_AREA) continue;
+        if (area > MAX_AREA_ABS) continue;
+        if (width > MAX_W_ABS || height > MAX_H_ABS) continue;
 
-            gboolean looks_like_I = (height >= MIN_HEIGHT_I && width <= MAX_WIDTH_I);
-            if (area < MIN_STRONG_AREA && !looks_like_I) continue;
-            if (!looks_like_I && (width < MIN_WIDTH || height < MIN_HEIGHT)) continue;
-            if (width > W / MAX_DIM_FACTOR || height > H / MAX_DIM_FACTOR) continue;
+        gboolean looks_like_I = (height >= MIN_HEIGHT_I && width <= MAX_WIDTH_I);
+        if (area < MIN_STRONG_AREA && !looks_like_I) continue;
+        if (!looks_like_I && (width < MIN_WIDTH || height < MIN_HEIGHT)) continue;
+        if (width > W / MAX_DIM_FACTOR || height > H / MAX_DIM_FACTOR) continue;
 
-            double aspect = (double)width / (double)height;
-            if (!looks_like_I && (aspect > ASPECT_MAX || aspect < 1.0 / ASPECT_MAX)) continue;
+        double aspect = (double)width / (double)height;
+        if (!looks_like_I && (aspect > ASPECT_MAX || aspect < 1.0 / ASPECT_MAX)) continue;
 
-            gboolean touches_grid = FALSE;
-            for (int xx = min_x; xx <= max_x && !touches_grid; ++xx)
-                if (xx >= 0 && xx < W && is_vline[xx]) touches_grid = TRUE;
+        gboolean touches_grid = FALSE;
+        for (int xx = min_x; xx <= max_x && !touches_grid; ++xx)
+            if (xx >= 0 && xx < W && is_vline[xx]) touches_grid = TRUE;
 
-            for (int yy = min_y; yy <= max_y && !touches_grid; ++yy)
-                if (yy >= 0 && yy < H && is_hline[yy]) touches_grid = TRUE;
+        for (int yy = min_y; yy <= max_y && !touches_grid; ++yy)
+            if (yy >= 0 && yy < H && is_hline[yy]) touches_grid = TRUE;
 
-            if (looks_like_I && touches_grid) continue;
-            if (touches_grid && (width < 10 || height < 10 || area < 100) && !looks_like_I) continue;
+        if (looks_like_I && touches_grid) continue;
+        if (touches_grid && (width < 10 || height < 10 || area < 100) && !looks_like_I) continue;
 
-            LetterCand lc;
-            memset(&lc, 0, sizeof(lc));
-            lc.min_x = min_x; lc.max_x = max_x;
-            lc.min_y = min_y; lc.max_y = max_y;
-            lc.width = width; lc.height = height; lc.area = area;
-            lc.looks_like_I = looks_like_I;
+        LetterCand lc;
+        memset(&lc, 0, sizeof(lc));
+        lc.min_x = min_x; lc.max_x = max_x;
+        lc.min_y = min_y; lc.max_y = max_y;
+        lc.width = width; lc.height = height; lc.area = area;
+        lc.looks_like_I = looks_like_I;
 
-            int cx = (min_x + max_x) / 2;
-            int cy = (min_y + max_y) / 2;
+        int cx = (min_x + max_x) / 2;
+        int cy = (min_y + max_y) / 2;
 
-            if (nv >= 2 && nh >= 2)
-            {
-                lc.col_idx = count_centers_before(vx, nv, cx);
-                lc.row_idx = count_centers_before(vy, nh, cy);
-            }
-            else
-            {
-                lc.col_idx = 0;
-                lc.row_idx = 0;
-            }
-
-            g_array_append_val(cands, lc);
+        if (nv >= 2 && nh >= 2)
+        {
+            lc.col_idx = count_centers_before(vx, nv, cx);
+            lc.row_idx = count_centers_before(vy, nh, cy);
         }
+        else
+        {
+            lc.col_idx = 0;
+            lc.row_idx = 0;
+        }
+
+        g_array_append_val(cands, lc);
     }
 
-    for (int y = 0; y < H; ++y) g_free(visited[y]);
-    g_free(visited);
+    g_free(vx);
+    g_free(vy);
 
     int letter_idx = 0;
 
@@ -923,10 +744,12 @@ int area   = width * height;
 
             qsort(linebuf, (size_t)len, sizeof(LetterCand), cmp_cx);
 
+            if (len > *max_cols) *max_cols = len;
+            *max_rows = row;
             for (int i = 0; i < len; ++i)
             {
                 int col = i + 1;
-                letter_idx = save_letter_normalized(img, disp,
+                letter_idx = save_letter_normalized(img, gray, disp, out,
                                                     linebuf[i].min_x, linebuf[i].min_y,
                                                     linebuf[i].max_x, linebuf[i].max_y,
                                                     R, G, B,
@@ -947,7 +770,7 @@ int area   = width * height;
             LetterCand lc = g_array_index(cands, LetterCand, i);
             if (lc.col_idx <= 0 || lc.row_idx <= 0) continue;
 
-            letter_idx = save_letter_normalized(img, disp,
+            letter_idx = save_letter_normalized(img, gray, disp, out,
                                                 lc.min_x, lc.min_y,
                                                 lc.max_x, lc.max_y,
                                                 R, G, B,
@@ -960,10 +783,10 @@ int area   = width * height;
     g_array_free(cands, TRUE);
     g_free(is_vline);
     g_free(is_hline);
-    g_object_unref(work);
 }
 
-void detect_letters_in_grid(GdkPixbuf *img, GdkPixbuf *disp,
+void detect_letters_in_grid(GdkPixbuf *img, const GrayImage *gray,
+                            GdkPixbuf *disp, GlyphBuffer *out,
                             int gx0, int gx1, int gy0, int gy1,
                             guint8 black_thr,
                             guint8 R, guint8 G, guint8 B)
@@ -972,6 +795,7 @@ void detect_letters_in_grid(GdkPixbuf *img, GdkPixbuf *disp,
     (void)R; 
     (void)G; 
     (void)B;
+    TRACE_SCOPE("grid_letters");
     int W = gdk_pixbuf_get_width(img);
     int H = gdk_pixbuf_get_height(img);
 
@@ -984,11 +808,11 @@ void detect_letters_in_grid(GdkPixbuf *img, GdkPixbuf *disp,
     if (gy0 > gy1) { int t = gy0; gy0 = gy1; gy1 = t; }
 
     if (gx1 - gx0 < 5 || gy1 - gy0 < 5) return;
+    trace_count(TRACE_PIXELS, (gint64)(gx1 - gx0 + 1) * (gy1 - gy0 + 1));
 
-    (void)ensure_dir("cells");
-
+    int start = out->len;
     int nb_cells = 0;
-    int nb_letters = detect_letters_by_cells(img, disp,
+    int nb_letters = detect_letters_by_cells(img, gray, disp, out,
                                              gx0, gx1, gy0, gy1,
                                              R, G, B,
                                              &nb_cells);
@@ -1001,8 +825,11 @@ void detect_letters_in_grid(GdkPixbuf *img, GdkPixbuf *disp,
     }
 
     gdk_pixbuf_copy_area(img, 0, 0, W, H, disp, 0, 0);
+    glyph_buffer_truncate(out, start);
 
-    detect_letters_legacy(img, disp, gx0, gx1, gy0, gy1, R, G, B);
+    int max_cols, max_rows;
+    detect_letters_legacy(img, gray, disp, out, gx0, gx1, gy0, gy1, R, G, B,
+                          &max_cols, &max_rows);
 
-    cleanup_cells_dir("cells", 14, 14);
+    keep_last_glyph_per_cell(out, start, max_cols, max_rows);
 }
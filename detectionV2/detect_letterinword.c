@@ -8,37 +8,25 @@
 #include <errno.h>
 #include <unistd.h>
 #include <math.h>
+#include "glyphs.h"
+#include "grayimage.h"
+#include "trace.h"
 
 #define LETTER_TARGET_W 48
 #define LETTER_TARGET_H 48
 
 // Prototypes internes
-static double* row_ratio_band(GdkPixbuf *img, guint8 thr, int x0, int x1);
-static int maybe_split_and_save_letter_word(GdkPixbuf *img, GdkPixbuf *disp,
+static double* row_ratio_band(const GrayImage *gray, guint8 thr, int x0, int x1);
+static int maybe_split_and_save_letter_word(GdkPixbuf *img, const GrayImage *gray,
+                                            GdkPixbuf *disp,
                                             int rx0,int ry0,int rx1,int ry1,
                                             guint8 black_thr,
                                             guint8 R,guint8 G,guint8 B,
-                                            const char *word_dir,
+                                            GlyphBuffer *out, int word_idx,
                                             int letter_idx);
 
 static inline int clampi(int v,int lo,int hi){ return (v<lo)?lo:((v>hi)?hi:v); }
 
-static inline int get_gray(GdkPixbuf *img, int x, int y)
-{
-    int W=gdk_pixbuf_get_width(img);
-    int H=gdk_pixbuf_get_height(img);
-    x=clampi(x,0,W-1);
-    y=clampi(y,0,H-1);
-
-    int nchan=gdk_pixbuf_get_n_channels(img);
-    int rs=gdk_pixbuf_get_rowstride(img);
-    guchar *p=gdk_pixbuf_get_pixels(img) + y*rs + x*nchan;
-
-    int r=p[0], g=p[1], b=p[2];
-    int gray=(299*r + 587*g + 114*b)/1000;
-    return clampi(gray,0,255);
-}
-
 static inline guint8 ink_thr_from(guint8 black_thr)
 {
     int t = (int)black_thr + 35;
@@ -79,51 +67,32 @@ static void draw_rect_thick(GdkPixbuf *pix, int x0,int y0,int x1,int y1,
     }
 }
 
-static int ensure_dir_local(const char *path)
-{
-    if(access(path, F_OK)==0) return 0;
-    if(mkdir(path,0755)==0) return 0;
-    if(errno==EEXIST) return 0;
-    fprintf(stderr,"[detect_letterinword] mkdir('%s') failed: %s\n", path, strerror(errno));
-    return -1;
-}
-
-static int ink_bbox(GdkPixbuf *img, int x0,int y0,int x1,int y1,
+static int ink_bbox(const GrayImage *gray, int x0,int y0,int x1,int y1,
                     guint8 thr, int *rx0,int *ry0,int *rx1,int *ry1)
 {
-    int W=gdk_pixbuf_get_width(img), H=gdk_pixbuf_get_height(img);
+    int W=gray->w, H=gray->h;
     x0=clampi(x0,0,W-1); x1=clampi(x1,0,W-1);
     y0=clampi(y0,0,H-1); y1=clampi(y1,0,H-1);
     if(x0>x1){ int t=x0;x0=x1;x1=t; }
     if(y0>y1){ int t=y0;y0=y1;y1=t; }
 
-    int found=0;
-    int minx=W-1, maxx=0, miny=H-1, maxy=0;
+    const InkTable *ink = gray_ink_table(gray, thr, x0, y0, x1, y1);
+    if(ink_count(ink,x0,y0,x1,y1)==0) return 0;
 
-    for(int y=y0;y<=y1;y++)
-    {
-        for(int x=x0;x<=x1;x++)
-        {
-            if(get_gray(img,x,y) < (int)thr)
-            {
-                if(x<minx) minx=x;
-                if(x>maxx) maxx=x;
-                if(y<miny) miny=y;
-                if(y>maxy) maxy=y;
-                found=1;
-            }
-        }
-    }
-
-    if(!found) return 0;
+    int minx=x0, maxx=x1, miny=y0, maxy=y1;
+    while(ink_count(ink,minx,y0,minx,y1)==0) minx++;
+    while(ink_count(ink,maxx,y0,maxx,y1)==0) maxx--;
+    while(ink_count(ink,minx,miny,maxx,miny)==0) miny++;
+    while(ink_count(ink,minx,maxy,maxx,maxy)==0) maxy--;
     *rx0=minx; *ry0=miny; *rx1=maxx; *ry1=maxy;
     return 1;
 }
 
-static int save_letter_with_margin_word(GdkPixbuf *img, GdkPixbuf *disp,
+static int save_letter_with_margin_word(GdkPixbuf *img, const GrayImage *gray,
+                                        GdkPixbuf *disp,
                                         int rx0,int ry0,int rx1,int ry1,
                                         guint8 R,guint8 G,guint8 B,
-                                        const char *word_dir,
+                                        GlyphBuffer *out, int word_idx,
                                         int letter_idx,
                                         int margin)
 {
@@ -147,35 +116,40 @@ static int save_letter_with_margin_word(GdkPixbuf *img, GdkPixbuf *disp,
     ww = clampi(ww, 1, W - sx);
     hh = clampi(hh, 1, H - sy);
 
-    GdkPixbuf *sub = gdk_pixbuf_new_subpixbuf(img, sx, sy, ww, hh);
-    if (!sub)
-        return letter_idx;
-
-    GdkPixbuf *scaled = gdk_pixbuf_scale_simple(
-        sub, LETTER_TARGET_W, LETTER_TARGET_H, GDK_INTERP_BILINEAR);
+    // A binary page gives the tile straight from the shared mask.
+    GdkPixbuf *scaled;
+    if (gray->binary)
+    {
+        scaled = gray_crop_scaled(gray, sx, sy, ww, hh, LETTER_TARGET_W, LETTER_TARGET_H);
+    }
+    else
+    {
+        GdkPixbuf *sub = gdk_pixbuf_new_subpixbuf(img, sx, sy, ww, hh);
+        if (!sub)
+            return letter_idx;
+        scaled = gdk_pixbuf_scale_simple(
+            sub, LETTER_TARGET_W, LETTER_TARGET_H, GDK_INTERP_BILINEAR);
+        g_object_unref(sub);
+    }
 
     if (scaled)
     {
-        char out_path[512];
-        snprintf(out_path, sizeof(out_path),
-                 "%s/letter_%03d.png", word_dir, letter_idx);
-
-        if (!gdk_pixbuf_save(scaled, out_path, "png", NULL, NULL))
-            fprintf(stderr, "[detect_letterinword] Save failed %s\n", out_path);
+        Glyph *g = glyph_buffer_push(out, scaled);
+        if (g) { g->word = word_idx; g->letter = letter_idx; g->idx = letter_idx; }
 
         g_object_unref(scaled);
         letter_idx++;
     }
 
-    g_object_unref(sub);
     return letter_idx;
 }
 
-static int maybe_split_and_save_letter_word(GdkPixbuf *img, GdkPixbuf *disp,
+static int maybe_split_and_save_letter_word(GdkPixbuf *img, const GrayImage *gray,
+                                            GdkPixbuf *disp,
                                             int rx0,int ry0,int rx1,int ry1,
                                             guint8 black_thr,
                                             guint8 R,guint8 G,guint8 B,
-                                            const char *word_dir,
+                                            GlyphBuffer *out, int word_idx,
                                             int letter_idx)
 {
     int Wsrc = gdk_pixbuf_get_width(img);
@@ -194,26 +168,22 @@ static int maybe_split_and_save_letter_word(GdkPixbuf *img, GdkPixbuf *disp,
         return letter_idx;
 
     if (width <= (int)(1.30 * height))
-        return save_letter_with_margin_word(img, disp, rx0, ry0, rx1, ry1,
-                                            R, G, B, word_dir, letter_idx, 3);
+        return save_letter_with_margin_word(img, gray, disp, rx0, ry0, rx1, ry1,
+                                            R, G, B, out, word_idx, letter_idx, 3);
 
     const guint8 ink_thr = ink_thr_from(black_thr);
 
     int wsub = width;
     double *col = (double*)malloc(sizeof(double) * (size_t)wsub);
     if (!col)
-        return save_letter_with_margin_word(img, disp, rx0, ry0, rx1, ry1,
-                                            R, G, B, word_dir, letter_idx, 3);
+        return save_letter_with_margin_word(img, gray, disp, rx0, ry0, rx1, ry1,
+                                            R, G, B, out, word_idx, letter_idx, 3);
 
+    const InkTable *ink = gray_ink_table(gray, ink_thr, rx0, ry0, rx1, ry1);
     for (int x = 0; x < wsub; x++)
     {
-        int gx = rx0 + x;
-        int black = 0, tot = 0;
-        for (int y = ry0; y <= ry1; y++)
-        {
-            if (get_gray(img, gx, y) < (int)ink_thr) black++;
-            tot++;
-        }
+        int black = ink_count(ink, rx0 + x, ry0, rx0 + x, ry1);
+        int tot = ry1 - ry0 + 1;
         col[x] = (tot > 0) ? (double)black / (double)tot : 0.0;
     }
 
@@ -240,9 +210,9 @@ static int maybe_split_and_save_letter_word(GdkPixbuf *img, GdkPixbuf *disp,
         int lx0, ly0, lx1, ly1;
         int rx0b, ry0b, rx1b, ry1b;
 
-        if (!ink_bbox(img, rx0, ry0, mid_x, ry1, ink_thr, &lx0, &ly0, &lx1, &ly1))
+        if (!ink_bbox(gray, rx0, ry0, mid_x, ry1, ink_thr, &lx0, &ly0, &lx1, &ly1))
             continue;
-        if (!ink_bbox(img, mid_x + 1, ry0, rx1, ry1, ink_thr, &rx0b, &ry0b, &rx1b, &ry1b))
+        if (!ink_bbox(gray, mid_x + 1, ry0, rx1, ry1, ink_thr, &rx0b, &ry0b, &rx1b, &ry1b))
             continue;
 
         int lw = lx1 - lx0 + 1, lh = ly1 - ly0 + 1;
@@ -268,75 +238,68 @@ static int maybe_split_and_save_letter_word(GdkPixbuf *img, GdkPixbuf *disp,
     free(col);
 
     if (best_split == -1)
-        return save_letter_with_margin_word(img, disp, rx0, ry0, rx1, ry1,
-                                            R, G, B, word_dir, letter_idx, 3);
+        return save_letter_with_margin_word(img, gray, disp, rx0, ry0, rx1, ry1,
+                                            R, G, B, out, word_idx, letter_idx, 3);
 
     int mid_x = rx0 + best_split;
 
     int lx0, ly0, lx1, ly1;
     int rx0b, ry0b, rx1b, ry1b;
 
-    if (!ink_bbox(img, rx0, ry0, mid_x, ry1, ink_thr, &lx0, &ly0, &lx1, &ly1))
-        return save_letter_with_margin_word(img, disp, rx0, ry0, rx1, ry1,
-                                            R, G, B, word_dir, letter_idx, 3);
+    if (!ink_bbox(gray, rx0, ry0, mid_x, ry1, ink_thr, &lx0, &ly0, &lx1, &ly1))
+        return save_letter_with_margin_word(img, gray, disp, rx0, ry0, rx1, ry1,
+                                            R, G, B, out, word_idx, letter_idx, 3);
 
-    if (!ink_bbox(img, mid_x + 1, ry0, rx1, ry1, ink_thr, &rx0b, &ry0b, &rx1b, &ry1b))
-        return save_letter_with_margin_word(img, disp, rx0, ry0, rx1, ry1,
-                                            R, G, B, word_dir, letter_idx, 3);
+    if (!ink_bbox(gray, mid_x + 1, ry0, rx1, ry1, ink_thr, &rx0b, &ry0b, &rx1b, &ry1b))
+        return save_letter_with_margin_word(img, gray, disp, rx0, ry0, rx1, ry1,
+                                            R, G, B, out, word_idx, letter_idx, 3);
 
-    letter_idx = maybe_split_and_save_letter_word(img, disp,
+    letter_idx = maybe_split_and_save_letter_word(img, gray, disp,
                                                   lx0, ly0, lx1, ly1,
                                                   black_thr, R, G, B,
-                                                  word_dir, letter_idx);
+                                                  out, word_idx, letter_idx);
 
-    letter_idx = maybe_split_and_save_letter_word(img, disp,
+    letter_idx = maybe_split_and_save_letter_word(img, gray, disp,
                                                   rx0b, ry0b, rx1b, ry1b,
                                                   black_thr, R, G, B,
-                                                  word_dir, letter_idx);
+                                                  out, word_idx, letter_idx);
 
     return letter_idx;
 }
 
-static double* row_ratio_band(GdkPixbuf *img, guint8 thr, int x0, int x1)
+static double* row_ratio_band(const GrayImage *gray, guint8 thr, int x0, int x1)
 {
-    int W=gdk_pixbuf_get_width(img), H=gdk_pixbuf_get_height(img);
+    int W=gray->w, H=gray->h;
     x0=clampi(x0,0,W-1); x1=clampi(x1,0,W-1);
     if(x0>x1){ int t=x0;x0=x1;x1=t; }
 
     double *row = (double*)malloc(sizeof(double)*(size_t)H);
     if(!row) return NULL;
 
+    int *black = (int*)malloc(sizeof(int)*(size_t)H);
+    if(!black){ free(row); return NULL; }
+    gray_ink_profiles(gray, thr, x0, x1, 0, H-1, NULL, black);
+    int tot = x1 - x0 + 1;
     for(int y=0;y<H;y++)
-    {
-        int black=0, tot=0;
-        for(int x=x0;x<=x1;x++)
-        {
-            if(get_gray(img,x,y) < (int)thr) black++;
-            tot++;
-        }
-        row[y] = (tot>0) ? ((double)black/(double)tot) : 0.0;
-    }
+        row[y] = (tot>0) ? ((double)black[y]/(double)tot) : 0.0;
+    free(black);
     return row;
 }
 
-static void process_word_band(GdkPixbuf *img, GdkPixbuf *disp,
+static void process_word_band(GdkPixbuf *img, const GrayImage *gray,
+                              GdkPixbuf *disp, GlyphBuffer *out,
                               int wx0, int wx1, int y0, int y1,
                               guint8 black_thr,
                               guint8 R, guint8 G, guint8 B,
                               int word_idx)
 {
-    const int Wsrc = gdk_pixbuf_get_width(img);
-    const int Hsrc = gdk_pixbuf_get_height(img);
+    const int Wsrc = gray->w;
+    const int Hsrc = gray->h;
 
     y0 = clampi(y0, 0, Hsrc - 1);
     y1 = clampi(y1, 0, Hsrc - 1);
     if (y1 - y0 + 1 < 6) return;
 
-    char word_dir[256];
-    snprintf(word_dir, sizeof(word_dir), "letterInWord/word_%03d", word_idx);
-    (void)ensure_dir_local("letterInWord");
-    (void)ensure_dir_local(word_dir);
-
     int Xleft = clampi(wx0, 0, Wsrc - 1);
     int Xright = clampi(wx1, 0, Wsrc - 1);
     int cw = Xright - Xleft + 1;
@@ -347,19 +310,20 @@ static void process_word_band(GdkPixbuf *img, GdkPixbuf *disp,
     double *col = (double*)malloc(sizeof(double) * (size_t)cw);
     if (!col) return;
 
+    int *black = (int*)malloc(sizeof(int) * (size_t)cw);
+    if (!black) { free(col); return; }
+    // One table over the band also serves the letter boxes cut from it.
+    ink_col_profile(gray_ink_table(gray, ink_thr, Xleft, y0, Xright, y1),
+                    Xleft, Xright, y0, y1, black);
+
     double maxc = 0.0;
+    int tot = y1 - y0 + 1;
     for (int x = 0; x < cw; x++)
     {
-        int gx = Xleft + x;
-        int black=0, tot=0;
-        for(int yy=y0; yy<=y1; yy++)
-        {
-            if(get_gray(img,gx,yy) < (int)ink_thr) black++;
-            tot++;
-        }
-        col[x] = (tot>0)?((double)black/(double)tot):0.0;
+        col[x] = (tot>0)?((double)black[x]/(double)tot):0.0;
         if (col[x] > maxc) maxc = col[x];
     }
+    free(black);
 
     double COL_INK_THR = 0.06;
     if (maxc < 0.10) COL_INK_THR = 0.04;
@@ -390,11 +354,11 @@ static void process_word_band(GdkPixbuf *img, GdkPixbuf *disp,
 
                 int rx0, ry0, rx1, ry1;
                 if ((X1 - X0) >= 1 &&
-                    ink_bbox(img, X0, y0, X1, y1, ink_thr, &rx0, &ry0, &rx1, &ry1))
+                    ink_bbox(gray, X0, y0, X1, y1, ink_thr, &rx0, &ry0, &rx1, &ry1))
                 {
                     letter_idx = maybe_split_and_save_letter_word(
-                        img, disp, rx0, ry0, rx1, ry1,
-                        black_thr, R, G, B, word_dir, letter_idx);
+                        img, gray, disp, rx0, ry0, rx1, ry1,
+                        black_thr, R, G, B, out, word_idx, letter_idx);
                 }
 
                 cx_in = 0;
@@ -410,24 +374,26 @@ static void process_word_band(GdkPixbuf *img, GdkPixbuf *disp,
 
         int rx0, ry0, rx1, ry1;
         if ((X1 - X0) >= 1 &&
-            ink_bbox(img, X0, y0, X1, y1, ink_thr, &rx0, &ry0, &rx1, &ry1))
+            ink_bbox(gray, X0, y0, X1, y1, ink_thr, &rx0, &ry0, &rx1, &ry1))
         {
             letter_idx = maybe_split_and_save_letter_word(
-                img, disp, rx0, ry0, rx1, ry1,
-                black_thr, R, G, B, word_dir, letter_idx);
+                img, gray, disp, rx0, ry0, rx1, ry1,
+                black_thr, R, G, B, out, word_idx, letter_idx);
         }
     }
 
     free(col);
 }
 
-void detect_letters_in_words(GdkPixbuf *img, GdkPixbuf *disp,
+void detect_letters_in_words(GdkPixbuf *img, const GrayImage *gray,
+                             GdkPixbuf *disp, GlyphBuffer *out,
                              int wx0,int wx1,int wy0,int wy1,
                              guint8 black_thr,
                              guint8 R,guint8 G,guint8 B)
 {
-    const int Wsrc=gdk_pixbuf_get_width(img);
-    const int Hsrc=gdk_pixbuf_get_height(img);
+    TRACE_SCOPE("word_letters");
+    const int Wsrc=gray->w;
+    const int Hsrc=gray->h;
 
     wx0 = clampi(wx0, 0, Wsrc - 1);
     wx1 = clampi(wx1, 0, Wsrc - 1);
@@ -435,20 +401,19 @@ void detect_letters_in_words(GdkPixbuf *img, GdkPixbuf *disp,
     wy1 = clampi(wy1, 0, Hsrc - 1);
     if (wx0 > wx1) { int t=wx0; wx0=wx1; wx1=t; }
     if (wy0 > wy1) { int t=wy0; wy0=wy1; wy1=t; }
+    trace_count(TRACE_PIXELS, (gint64)(wx1 - wx0 + 1) * (wy1 - wy0 + 1));
 
     int initial_wx1 = wx1;
     int max_x = clampi(wx1 + 200, 0, Wsrc - 1);
     const double GRID_DENSITY_THRESHOLD = 0.5;
 
+    int black[200];
+    if (max_x > initial_wx1)
+        gray_ink_profiles(gray, black_thr, initial_wx1 + 1, max_x, wy0, wy1, black, NULL);
     for (int x = initial_wx1 + 1; x <= max_x; x++)
     {
-        int black_count = 0;
-        int total_count = 0;
-        for (int y = wy0; y <= wy1; y++)
-        {
-            if (get_gray(img, x, y) < (int)black_thr) black_count++;
-            total_count++;
-        }
+        int black_count = black[x - initial_wx1 - 1];
+        int total_count = wy1 - wy0 + 1;
         if (total_count > 0 &&
             ((double)black_count / (double)total_count) > GRID_DENSITY_THRESHOLD)
         {
@@ -458,9 +423,7 @@ void detect_letters_in_words(GdkPixbuf *img, GdkPixbuf *disp,
     }
     wx1 = max_x;
 
-    (void)ensure_dir_local("letterInWord");
-
-    double *row = row_ratio_band(img, black_thr, wx0, wx1);
+    double *row = row_ratio_band(gray, black_thr, wx0, wx1);
     if(!row) return;
 
     int in=0, ystart=0, last=-1000000000;
@@ -481,7 +444,7 @@ void detect_letters_in_words(GdkPixbuf *img, GdkPixbuf *disp,
             int y0=ystart, y1=last;
             in=0;
 
-            process_word_band(img, disp, wx0, wx1, y0, y1,
+            process_word_band(img, gray, disp, out, wx0, wx1, y0, y1,
                               black_thr, R, G, B, word_idx);
 
             word_idx++;
@@ -491,7 +454,7 @@ void detect_letters_in_words(GdkPixbuf *img, GdkPixbuf *disp,
     if(in)
     {
         int y0=ystart, y1=last;
-        process_word_band(img, disp, wx0, wx1, y0, y1,
+        process_word_band(img, gray, disp, out, wx0, wx1, y0, y1,
                           black_thr, R, G, B, word_idx);
     }
 
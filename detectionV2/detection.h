@@ -1,6 +1,60 @@
 #ifndef DETECTION_H
 #define DETECTION_H
 
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include "skew.h"
+#include "binarize.h"
+
 int detection_run_app(int argc, char **argv);
 
+// Runs detect -> recognize -> solve on each image without GTK.
+// argv[0] is the subcommand name, argv[1..] the images.
+int detection_run_batch(int argc, char **argv);
+
+// ./ocr_project serve: keeps the model resident and solves the images sent
+// over a UNIX socket (server.c).
+int detection_run_server(int argc, char **argv);
+
+// Headless pipeline shared by batch and serve.
+enum {
+    DETECT_STAGE_DECODE,
+    DETECT_STAGE_DESKEW,
+    DETECT_STAGE_BINARIZE,
+    DETECT_STAGE_ZONES,
+    DETECT_STAGE_GRID,
+    DETECT_STAGE_WORDS,
+    DETECT_STAGE_RECOGNIZE,
+    DETECT_STAGE_SOLVE,
+    DETECT_STAGE_COUNT
+};
+
+const char *detection_stage_name(int stage);
+
+typedef struct
+{
+    gboolean deskew;
+    SkewMethod skew_method;
+    BinMethod bin;
+    gboolean dump_glyphs;
+} DetectionOptions;
+
+// Defaults, OCR_BINARIZE included.
+void detection_options_init(DetectionOptions *opt);
+// Reads the --dump-glyphs, --deskew M and --binarize M options found from
+// argv[first]. Returns the index of the first argument that is not one of
+// them, or -1 when one of them has a missing or unknown value.
+int detection_parse_options(int argc, char **argv, int first, DetectionOptions *opt);
+
+// Page buffers and glyphs of one thread, reused from image to image.
+typedef struct DetectionWorker DetectionWorker;
+
+DetectionWorker *detection_worker_new(const DetectionOptions *opt);
+void detection_worker_free(DetectionWorker *w);
+
+// Solves one decoded page in memory (no file, no global state) and returns
+// a JSON object with the grid, the words and their positions (g_free).
+// Stage durations, in microseconds, are added to stage_us.
+char *detection_worker_solve_json(DetectionWorker *w, GdkPixbuf *img,
+                                  gint64 stage_us[DETECT_STAGE_COUNT]);
+
 #endif
@@ -7,17 +7,31 @@
 #include <string.h>
 #include "detection.h"
 #include "networks.h"
+#include "glyphs.h"
+#include "quantize.h"
+#include "model.h"
+#include "bitinput.h"
+#include "workers.h"
+#include "pipeline.h"
+#include "trace.h"
+#include "grayimage.h"
+#include "binarize.h"
+#include "skew.h"
+#include "rotate.h"
 
 
 #ifdef MAX
 #undef MAX
 #endif
 #include "solver.h"
+#include "gridindex.h"
+#include "ahocorasick.h"
 
 static char *g_last_image_path = NULL;
 static int g_grid_x0 = 0, g_grid_y0 = 0, g_grid_x1 = 0, g_grid_y1 = 0;
 static int g_grid_bbox_set = 0;
 static GtkWidget *g_detect_window = NULL;
+static GlyphBuffer g_glyphs;
 
 static void on_detect_destroy(GtkWidget *widget, gpointer user_data)
 {
@@ -38,10 +52,13 @@ typedef struct
     int x0, y0, x1, y1;
 } CellBBox;
 
-void detect_letters_in_grid(GdkPixbuf *img, GdkPixbuf *disp,
+// gray: (r+g+b)/3 copy of img for the grid, luma copy for the word list
+void detect_letters_in_grid(GdkPixbuf *img, const GrayImage *gray,
+                            GdkPixbuf *disp, GlyphBuffer *out,
                             int gx0,int gx1,int gy0,int gy1,
                             guint8 black_thr, guint8 R,guint8 G,guint8 B);
-void detect_letters_in_words(GdkPixbuf *img, GdkPixbuf *disp,
+void detect_letters_in_words(GdkPixbuf *img, const GrayImage *gray,
+                             GdkPixbuf *disp, GlyphBuffer *out,
                              int wx0,int wx1,int wy0,int wy1,
                              guint8 black_thr, guint8 R,guint8 G,guint8 B);
 
@@ -50,11 +67,60 @@ static inline int clampi(int v,int lo,int hi)
     return v<lo?lo:(v>hi?hi:v);
 }
 
-static inline guint8 get_gray_local(GdkPixbuf *pix,int x,int y)
+// Both gray conversions the detectors use, done once per loaded page.
+typedef struct
+{
+    GrayImage avg;
+    GrayImage luma;
+    GrayImage scratch;   // rotation target, swapped with the planes
+    BinMethod bin;       // shared ink mask, BIN_NONE keeps the stage thresholds
+    BitImage mask;
+} PageGray;
+
+static void page_gray_init(PageGray *pg)
+{
+    gray_image_init(&pg->avg);
+    gray_image_init(&pg->luma);
+    gray_image_init(&pg->scratch);
+    pg->bin = bin_method_from_env();
+    bit_image_init(&pg->mask);
+}
+
+// Also used to release a page's planes once segmented: pg can be loaded again.
+static void page_gray_free(PageGray *pg)
+{
+    gray_image_free(&pg->avg);
+    gray_image_free(&pg->luma);
+    gray_image_free(&pg->scratch);
+    bit_image_free(&pg->mask);
+}
+
+// With a binarization method, both planes become the same 0/255 mask so every
+// detector sees the same ink whatever its own threshold.
+static void page_gray_binarize(PageGray *pg)
+{
+    if (pg->bin == BIN_NONE) return;
+    binarize(&pg->luma, pg->bin, &pg->mask);
+    gray_image_from_bits(&pg->avg, &pg->mask);
+    gray_image_from_bits(&pg->luma, &pg->mask);
+}
+
+static gboolean page_gray_load(PageGray *pg, const GdkPixbuf *img)
 {
-    int n=gdk_pixbuf_get_n_channels(pix);
-    guchar *p=gdk_pixbuf_get_pixels(pix)+y*gdk_pixbuf_get_rowstride(pix)+x*n;
-    return (p[0]+p[1]+p[2])/3;
+    return gray_image_from_pixbuf(&pg->avg, img, GRAY_AVG)
+        && gray_image_from_pixbuf(&pg->luma, img, GRAY_LUMA);
+}
+
+// Rotates both planes in place, like rotate_pixbuf() on the page.
+static void page_gray_rotate(PageGray *pg, double angle_deg)
+{
+    GrayImage *planes[2] = { &pg->avg, &pg->luma };
+    for (int i = 0; i < 2; i++) {
+        rotate_gray(planes[i], &pg->scratch, angle_deg, ROTATE_BILINEAR);
+        GrayImage t = *planes[i];
+        *planes[i] = pg->scratch;
+        pg->scratch = t;
+    }
 }
 
 static void draw_rect(GdkPixbuf *pix,int x0,int y0,int x1,int y1,
@@ -204,11 +270,11 @@ __attribute__((unused)) static void refine_box_position(GdkPixbuf *pix, int *p1x
     }
 }
 
-__attribute__((unused)) static double *col_black_ratio_zone(GdkPixbuf *pix, guint8 thr,
+__attribute__((unused)) static double *col_black_ratio_zone(const GrayImage *gray, guint8 thr,
                                      int x0, int x1)
 {
-    int W = gdk_pixbuf_get_width(pix);
-    int H = gdk_pixbuf_get_height(pix);
+    int W = gray->w;
+    int H = gray->h;
     x0 = clampi(x0, 0, W-1);
     x1 = clampi(x1, 0, W-1);
     if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
@@ -217,15 +283,11 @@ __attribute__((unused)) static double *col_black_ratio_zone(GdkPixbuf *pix, guin
     double *r = calloc(n, sizeof(double));
     if (!r) return NULL;
 
+    int *black = g_malloc((gsize)n * sizeof(int));
+    gray_ink_profiles(gray, thr, x0, x1, 0, H - 1, black, NULL);
     for (int i = 0; i < n; i++)
-    {
-        int x = x0 + i;
-        int black = 0;
-        for (int y = 0; y < H; y++)
-            if (get_gray_local(pix, x, y) < thr)
-                black++;
-        r[i] = (double)black / (double)H;
-    }
+        r[i] = (double)black[i] / (double)H;
+    g_free(black);
     return r;
 }
 
@@ -272,20 +334,21 @@ __attribute__((unused)) static double periodicity_score(const double *p, int n)
 }
 
 
-static void write_cell_positions(const char *root_dir, int nb_rows, int nb_cols)
+// bbox: x0, y0, x1, y1 of the grid zone
+static void write_cell_positions(const char *root_dir, int nb_rows, int nb_cols, const int bbox[4])
 {
-    if (!root_dir || !g_grid_bbox_set || nb_rows <= 0 || nb_cols <= 0) return;
-    double stepX = (double)(g_grid_x1 - g_grid_x0 + 1) / (double)nb_cols;
-    double stepY = (double)(g_grid_y1 - g_grid_y0 + 1) / (double)nb_rows;
+    if (!root_dir || !bbox || nb_rows <= 0 || nb_cols <= 0) return;
+    double stepX = (double)(bbox[2] - bbox[0] + 1) / (double)nb_cols;
+    double stepY = (double)(bbox[3] - bbox[1] + 1) / (double)nb_rows;
 
     char *pos_path = g_build_filename(root_dir, "CELLPOS", NULL);
     GString *out = g_string_new("");
     for (int r = 0; r < nb_rows; r++) {
         for (int c = 0; c < nb_cols; c++) {
-            int x0 = g_grid_x0 + (int)floor(c * stepX);
-            int y0 = g_grid_y0 + (int)floor(r * stepY);
-            int x1 = g_grid_x0 + (int)floor((c + 1) * stepX) - 1;
-            int y1 = g_grid_y0 + (int)floor((r + 1) * stepY) - 1;
+            int x0 = bbox[0] + (int)floor(c * stepX);
+            int y0 = bbox[1] + (int)floor(r * stepY);
+            int x1 = bbox[0] + (int)floor((c + 1) * stepX) - 1;
+            int y1 = bbox[1] + (int)floor((r + 1) * stepY) - 1;
             g_string_append_printf(out, "%d %d %d %d %d %d\n", c, r, x0, y0, x1, y1);
         }
     }
@@ -294,6 +357,7 @@ static void write_cell_positions(const char *root_dir, int nb_rows, int nb_cols)
         g_printerr("[Warn] Cannot write CELLPOS (%s): %s\n", pos_path, err->message);
         g_clear_error(&err);
     } else {
+        trace_count(TRACE_FILES, 1);
         g_print("[Info] CELLPOS generated -> %s\n", pos_path);
     }
     g_string_free(out, TRUE);
@@ -376,13 +440,6 @@ static inline WordColor word_color_for_index(int idx)
     return WORD_COLORS[idx % WORD_COLORS_LEN];
 }
 
-static int cmp_str_ptr(const void *a, const void *b)
-{
-    const char *sa = *(const char * const *)a;
-    const char *sb = *(const char * const *)b;
-    return g_strcmp0(sa, sb);
-}
-
 static int compare_cells_row_major(const void *a, const void *b)
 {
     const CellPrediction *ca = *(const CellPrediction * const *)a;
@@ -391,37 +448,65 @@ static int compare_cells_row_major(const void *a, const void *b)
     return ca->col - cb->col;
 }
 
-static char predict_letter_for_cell(NeuralNetwork *net, const char *filepath)
+_Static_assert(GLYPH_W == IMAGE_WIDTH && GLYPH_H == IMAGE_HEIGHT,
+               "glyph tiles must match the network input size");
+
+typedef struct
+{
+    const NeuralNetwork *net;
+    const CompactNet *compact;   // NULL: double network on bit masks
+    const GlyphBuffer *glyphs;
+    char *letters;
+    int chunk;
+} ClassifyJob;
+
+// One task = one chunk of glyphs; scratch lives on the worker's stack.
+static void classify_chunk(int task, void *ctx)
 {
-    double conf = 0.0;
-    char res = predict(net, filepath, &conf);
-    if (res >= 'a' && res <= 'z') res = res - 32;
-    return res;
+    ClassifyJob *job = ctx;
+    int start = task * job->chunk;
+    int n = MIN(job->chunk, job->glyphs->len - start);
+    const Glyph *items = job->glyphs->items + start;
+
+    if (job->compact) {
+        double *inputs = g_malloc((gsize)n * NUM_INPUTS * sizeof(double));
+        for (int i = 0; i < n; i++)
+            preprocess_pixels(items[i].pixels, inputs + (size_t)i * NUM_INPUTS);
+        compact_predict_batch(job->compact, inputs, n, job->letters + start, NULL);
+        g_free(inputs);
+    } else {
+        // Binary inputs travel as bit masks; only ink pixels reach the first layer.
+        BitInput *bits = g_malloc((gsize)n * sizeof(BitInput));
+        for (int i = 0; i < n; i++)
+            bits_from_pixels(items[i].pixels, &bits[i]);
+        predict_bits_batch(job->net, bits, n, job->letters + start, NULL);
+        g_free(bits);
+    }
 }
 
-static char *find_project_root(void)
+// Classifies every glyph on the worker pool; returns one letter per glyph.
+static char *classify_glyphs(const OcrModel *model, const GlyphBuffer *glyphs)
 {
-    char *cwd = g_get_current_dir();
-    if (!cwd) return NULL;
-    for (int i = 0; i < 5; i++) {
-        char *cells_path = g_build_filename(cwd, "cells", NULL);
-        gboolean ok = g_file_test(cells_path, G_FILE_TEST_IS_DIR);
-        g_free(cells_path);
-        if (ok) return cwd;
-
-        char *parent = g_path_get_dirname(cwd);
-        if (!parent || g_strcmp0(parent, cwd) == 0) {
-            g_free(parent);
-            break;
-        }
-        g_free(cwd);
-        cwd = parent;
-    }
-    g_free(cwd);
-    return NULL;
+    TRACE_SCOPE("recognize");
+    trace_count(TRACE_GLYPHS, glyphs->len);
+    char *letters = g_malloc0((gsize)glyphs->len + 1);
+    if (glyphs->len == 0) return letters;
+
+    // Grid cells and word letters are split evenly over the pool, in whole
+    // BATCH_TILE blocks so predict_*_batch keeps its row reuse.
+    int workers = workers_count();
+    int chunk = (glyphs->len + workers - 1) / workers;
+    chunk = (chunk + BATCH_TILE - 1) / BATCH_TILE * BATCH_TILE;
+    const CompactNet *compact = model->precision != PRECISION_F64 ? &model->compact : NULL;
+    ClassifyJob job = { &model->net, compact, glyphs, letters, chunk };
+    workers_run((glyphs->len + chunk - 1) / chunk, classify_chunk, &job);
+
+    for (int i = 0; i < glyphs->len; i++)
+        if (letters[i] >= 'a' && letters[i] <= 'z') letters[i] -= 32;
+    return letters;
 }
 
-static void write_gridl_file(const char *root_dir, const GPtrArray *cells, int max_row, int max_col)
+static void append_gridl_text(GString *out, const GPtrArray *cells, int max_row, int max_col)
 {
     if (max_row <= 0 || max_col <= 0) return;
     char *grid = g_malloc0((size_t)max_row * (size_t)max_col);
@@ -435,23 +520,10 @@ static void write_gridl_file(const char *root_dir, const GPtrArray *cells, int m
             grid[(size_t)r * (size_t)max_col + (size_t)c] = cp->letter;
     }
 
-    GString *out = g_string_new("");
     for (int r = 0; r < max_row; r++) {
         g_string_append_len(out, grid + (size_t)r * (size_t)max_col, max_col);
         g_string_append_c(out, '\n');
     }
-
-    char *gridl_path = root_dir ? g_build_filename(root_dir, "GRIDL", NULL) : g_strdup("GRIDL");
-    GError *err = NULL;
-    if (g_file_set_contents(gridl_path, out->str, -1, &err))
-        g_print("[Info] GRIDL file updated (%dx%d) -> %s\n", max_col, max_row, gridl_path);
-    else {
-        g_printerr("[Error] GRIDL write failed (%s): %s\n", gridl_path, err->message);
-        g_clear_error(&err);
-    }
-    g_free(gridl_path);
-
-    g_string_free(out, TRUE);
     g_free(grid);
 }
 
@@ -480,38 +552,40 @@ static void show_solver_overlay(const GPtrArray *results, int nb_rows, int nb_co
     int corrected_x0 = gx0, corrected_x1 = gx1;
     int corrected_y0 = gy0, corrected_y1 = gy1;
     const int threshold = 160; 
+
+    // Trim the grid box to the first rows/columns with ink (1-bit mask).
+    GrayImage gray;
+    BitImage ink_mask;
+    gray_image_init(&gray);
+    bit_image_init(&ink_mask);
+    gray_image_from_pixbuf(&gray, img, GRAY_AVG);
+    bit_image_from_gray(&ink_mask, &gray, threshold);
+    gray_image_free(&gray);
     
     for (int y = gy0; y <= gy1; y++) {
-        int ink = 0;
-        for (int x = gx0; x <= gx1; x++) {
-            if (get_gray_local(img, x, y) < threshold) ink++;
-        }
+        int ink = bit_count_row(&ink_mask, y, gx0, gx1);
         if (ink > (gx1 - gx0) * 0.02) { corrected_y0 = y; break; }
     }
 
     for (int y = gy1; y >= corrected_y0; y--) {
-        int ink = 0;
-        for (int x = gx0; x <= gx1; x++) {
-            if (get_gray_local(img, x, y) < threshold) ink++;
-        }
+        int ink = bit_count_row(&ink_mask, y, gx0, gx1);
         if (ink > (gx1 - gx0) * 0.02) { corrected_y1 = y; break; }
     }
 
     for (int x = gx0; x <= gx1; x++) {
         int ink = 0;
-        for (int y = corrected_y0; y <= corrected_y1; y++) {
-            if (get_gray_local(img, x, y) < threshold) ink++;
-        }
+        for (int y = corrected_y0; y <= corrected_y1; y++)
+            ink += bit_at(&ink_mask, x, y);
         if (ink > 5) { corrected_x0 = x; break; }
     }
 
     for (int x = gx1; x >= corrected_x0; x--) {
         int ink = 0;
-        for (int y = corrected_y0; y <= corrected_y1; y++) {
-            if (get_gray_local(img, x, y) < threshold) ink++;
-        }
+        for (int y = corrected_y0; y <= corrected_y1; y++)
+            ink += bit_at(&ink_mask, x, y);
         if (ink > 5) { corrected_x1 = x; break; }
     }
+    bit_image_free(&ink_mask);
 
     double final_w = (double)(corrected_x1 - corrected_x0);
     double final_h = (double)(corrected_y1 - corrected_y0);
@@ -590,8 +664,6 @@ static void show_solver_overlay(const GPtrArray *results, int nb_rows, int nb_co
 
     g_object_unref(img);
     g_object_unref(disp);
-    char *rd = find_project_root();
-    if(rd) g_free(rd);
 }
 
 __attribute__((unused)) static int detect_grid_bbox(GdkPixbuf *img, int *x0, int *y0, int *x1, int *y1)
@@ -696,6 +768,86 @@ __attribute__((unused)) static int detect_grid_bbox(GdkPixbuf *img, int *x0, int
     return 1;
 }
 
+static void solve_result_free(gpointer p)
+{
+    SolveResult *sr = p;
+    g_free(sr->word);
+    g_free(sr);
+}
+
+// Looks up every line of words_text (one word per line) in grille.
+// OCR_SOLVER=aho: one automaton sweep for the whole list,
+// scan: ChercheMot per word, default: grid index per word.
+static GPtrArray *solve_words(const Grid *grille, const char *words_text)
+{
+    TRACE_SCOPE("solve");
+    GPtrArray *results = g_ptr_array_new_with_free_func(solve_result_free);
+    char **lines = g_strsplit(words_text, "\n", -1);
+    for (char **l = lines; *l; l++) {
+        char *line = *l;
+        line[strcspn(line, "\r")] = '\0';
+        if (line[0] == '\0') continue;
+        ConvertirMajuscules(line);
+        SolveResult *sr = g_malloc(sizeof(SolveResult));
+        sr->word = g_strdup(line);
+        sr->c1 = sr->r1 = sr->c2 = sr->r2 = -1;
+        sr->found = 0;
+        g_ptr_array_add(results, sr);
+    }
+    g_strfreev(lines);
+
+    const char *solver = g_getenv("OCR_SOLVER");
+    gboolean solved = FALSE;
+    if (solver && strcmp(solver, "aho") == 0) {
+        int n = (int)results->len;
+        const char **words = g_malloc(sizeof(char *) * (n > 0 ? n : 1));
+        for (int i = 0; i < n; i++)
+            words[i] = ((SolveResult *)g_ptr_array_index(results, i))->word;
+        AcAutomaton ac;
+        if (ac_build(&ac, words, n)) {
+            AcMatch *first = g_malloc(sizeof(AcMatch) * (n > 0 ? n : 1));
+            int *found = g_malloc(sizeof(int) * (n > 0 ? n : 1));
+            ac_find_first(&ac, grille, first, found);
+            for (int i = 0; i < n; i++) {
+                SolveResult *sr = g_ptr_array_index(results, i);
+                if (!found[i]) continue;
+                sr->found = 1;
+                sr->r1 = first[i].ligneDebut; sr->c1 = first[i].colDebut;
+                sr->r2 = first[i].ligneFin; sr->c2 = first[i].colFin;
+            }
+            g_free(found);
+            g_free(first);
+            ac_free(&ac);
+            solved = TRUE;
+        }
+        g_free(words);
+    }
+    if (!solved) {
+        GridIndex ix;
+        int indexed = !(solver && strcmp(solver, "scan") == 0)
+                      && grid_index_build(&ix, grille);
+        for (guint i = 0; i < results->len; i++) {
+            SolveResult *sr = g_ptr_array_index(results, i);
+            sr->found = indexed
+                ? grid_index_find(&ix, sr->word, &sr->r1, &sr->c1, &sr->r2, &sr->c2)
+                : ChercheMot(sr->word, grille, &sr->r1, &sr->c1, &sr->r2, &sr->c2);
+        }
+        if (indexed) grid_index_free(&ix);
+    }
+    return results;
+}
+
+static void print_solve_results(const GPtrArray *results)
+{
+    for (guint i = 0; i < results->len; i++) {
+        const SolveResult *sr = g_ptr_array_index((GPtrArray *)results, i);
+        if (sr->found)
+            g_print("[SOLVE] %s -> (%d,%d)(%d,%d)\n", sr->word, sr->c1, sr->r1, sr->c2, sr->r2);
+        else
+            g_print("[SOLVE] %s -> Not found\n", sr->word);
+    }
+}
+
 static int solve_words_in_grid(const char *root_dir,
                                GPtrArray **out_results, int *out_rows, int *out_cols)
 {
@@ -707,48 +859,32 @@ static int solve_words_in_grid(const char *root_dir,
     char *grid_path = g_build_filename(root_dir, "GRIDL", NULL);
     char *words_path = g_build_filename(root_dir, "GRIDWO", NULL);
 
-    char matrice[MAX_MAT][MAX_MAT]; // Updated to MAX_MAT
-    int nbLignes = CreaMatrice(grid_path, matrice);
+    Grid grille;
+    int nbLignes = CreaMatrice(grid_path, &grille);
     if (nbLignes <= 0) {
         g_printerr("[Error] GRIDL read failed (%s)\n", grid_path);
         g_free(grid_path);
         g_free(words_path);
         return 0;
     }
-    int nbColonnes = (int)strlen(matrice[0]);
+    int nbColonnes = grille.width;
     if (out_rows) *out_rows = nbLignes;
     if (out_cols) *out_cols = nbColonnes;
 
-    FILE *fw = fopen(words_path, "r");
-    if (!fw) {
+    // No line length limit: words of large generated grids can be long.
+    char *contents = NULL;
+    if (!g_file_get_contents(words_path, &contents, NULL, NULL)) {
         g_printerr("[Error] GRIDWO read failed (%s)\n", words_path);
+        grid_free(&grille);
         g_free(grid_path);
         g_free(words_path);
         return 0;
     }
 
-    GPtrArray *results = g_ptr_array_new_with_free_func(g_free);
-    char line[256];
-    while (fgets(line, sizeof(line), fw)) {
-        line[strcspn(line, "\r\n")] = '\0';
-        if (line[0] == '\0') continue;
-        ConvertirMajuscules(line);
-
-        int li1=-1, li2=-1, co1=-1, co2=-1;
-        int found = ChercheMot(line, matrice, nbLignes, nbColonnes, &li1, &co1, &li2, &co2);
-        if (found)
-            g_print("[SOLVE] %s -> (%d,%d)(%d,%d)\n", line, co1, li1, co2, li2);
-        else
-            g_print("[SOLVE] %s -> Not found\n", line);
-
-        SolveResult *sr = g_malloc(sizeof(SolveResult));
-        sr->word = g_strdup(line);
-        sr->c1 = co1; sr->r1 = li1; sr->c2 = co2; sr->r2 = li2;
-        sr->found = found;
-        g_ptr_array_add(results, sr);
-    }
-
-    fclose(fw);
+    GPtrArray *results = solve_words(&grille, contents);
+    print_solve_results(results);
+    g_free(contents);
+    grid_free(&grille);
     if (out_results) *out_results = results;
     else g_ptr_array_free(results, TRUE);
 
@@ -757,149 +893,126 @@ static int solve_words_in_grid(const char *root_dir,
     return 1;
 }
 
-static void run_solver_pipeline(void)
+// GRIDL contents from the letters predicted for the grid glyphs.
+// Returns the number of recognized cells.
+static int build_gridl_text(const GlyphBuffer *glyphs, const char *letters,
+                            GString *out, int *nb_rows, int *nb_cols)
 {
-    char *root_dir = find_project_root();
-    if (!root_dir) {
-        g_printerr("[Error] Cannot locate 'cells' folder. Aborting.\n");
-        return;
-    }
-
-    NeuralNetwork net;
-    init_network(&net);
-
-    const char *save_file = "neuronne/brain.bin";
-    if (!load_network(&net, save_file)) {
-        g_printerr("[Warn] No network save found. Training in progress...\n");
-        train_network(&net, "neuronne/dataset");
-        save_network(&net, save_file);
-    }
-
     GPtrArray *cells = g_ptr_array_new_with_free_func(g_free);
-    char *cells_path = g_build_filename(root_dir, "cells", NULL);
-    GDir *dir = g_dir_open(cells_path, 0, NULL);
-    if (!dir) {
-        g_printerr("[Error] Cannot open cells folder (%s)\n", cells_path);
-        g_free(cells_path);
-        g_free(root_dir);
-        g_ptr_array_free(cells, TRUE);
-        cleanup(&net);
-        return;
-    }
 
     int max_row = 0, max_col = 0;
-    int cell_w = 0, cell_h = 0;
-    const char *name = NULL;
-    while ((name = g_dir_read_name(dir)) != NULL) {
-        int col = 0, row = 0;
-        if (sscanf(name, "%d_%d", &col, &row) != 2)
-            continue;
-
-        char *fullpath = g_build_filename(cells_path, name, NULL);
-        if (cell_w == 0 || cell_h == 0) {
-            int w = 0, h = 0;
-            if (gdk_pixbuf_get_file_info(fullpath, &w, &h)) {
-                cell_w = w;
-                cell_h = h;
-            }
-        }
-
-        char letter = predict_letter_for_cell(&net, fullpath);
+    for (int i = 0; i < glyphs->len; i++) {
+        const Glyph *g = &glyphs->items[i];
+        if (g->word >= 0) continue;
 
         CellPrediction *cp = g_malloc(sizeof(CellPrediction));
-        cp->col = col;
-        cp->row = row;
-        cp->letter = letter;
+        cp->col = g->col;
+        cp->row = g->row;
+        cp->letter = letters[i];
         g_ptr_array_add(cells, cp);
 
-        if (row > max_row) max_row = row;
-        if (col > max_col) max_col = col;
-
-        g_free(fullpath);
+        if (g->row > max_row) max_row = g->row;
+        if (g->col > max_col) max_col = g->col;
     }
-    g_dir_close(dir);
-    g_free(cells_path);
 
-    if (cells->len == 0) {
-        g_printerr("[Error] No files in cells/*\n");
-        g_ptr_array_free(cells, TRUE);
-        cleanup(&net);
-        g_free(root_dir);
-        return;
+    int nb_cells = (int)cells->len;
+    if (nb_cells > 0) {
+        qsort(cells->pdata, cells->len, sizeof(gpointer), compare_cells_row_major);
+        append_gridl_text(out, cells, max_row, max_col);
     }
-
-    qsort(cells->pdata, cells->len, sizeof(gpointer), compare_cells_row_major);
-    write_gridl_file(root_dir, cells, max_row, max_col);
-    write_cell_positions(root_dir, max_row, max_col);
+    *nb_rows = max_row;
+    *nb_cols = max_col;
 
     g_ptr_array_free(cells, TRUE);
+    return nb_cells;
+}
 
-    char *words_dir = g_build_filename(root_dir, "letterInWord", NULL);
-    GDir *words = g_dir_open(words_dir, 0, NULL);
-    if (!words) {
-        g_printerr("[Warn] letterInWord folder not found (%s), GRIDWO not generated.\n", words_dir);
-    } else {
-        GPtrArray *word_names = g_ptr_array_new_with_free_func(g_free);
-        const char *wname = NULL;
-        while ((wname = g_dir_read_name(words)) != NULL) {
-            if (g_str_has_prefix(wname, "word_"))
-                g_ptr_array_add(word_names, g_strdup(wname));
+// GRIDWO contents from the letters predicted for the word glyphs, one word
+// per line. Word glyphs are pushed band by band, letters left to right.
+static void build_gridwo_text(const GlyphBuffer *glyphs, const char *letters, GString *out)
+{
+    int cur_word = -1;
+    for (int i = 0; i < glyphs->len; i++) {
+        const Glyph *g = &glyphs->items[i];
+        if (g->word < 0) continue;
+
+        if (g->word != cur_word) {
+            if (cur_word >= 0) g_string_append_c(out, '\n');
+            cur_word = g->word;
         }
-        g_dir_close(words);
+        g_string_append_c(out, letters[i]);
+    }
+    if (cur_word >= 0) g_string_append_c(out, '\n');
+}
 
-        if (word_names->len == 0) {
-            g_printerr("[Warn] No word_* folder in letterInWord, GRIDWO empty.\n");
-        } else {
-            qsort(word_names->pdata, word_names->len, sizeof(gpointer), cmp_str_ptr);
-            GString *out_words = g_string_new("");
-
-            for (guint wi = 0; wi < word_names->len; wi++) {
-                char *word_path = g_build_filename(words_dir, (char *)g_ptr_array_index(word_names, wi), NULL);
-                GDir *letters_dir = g_dir_open(word_path, 0, NULL);
-                if (!letters_dir) {
-                    g_printerr("[Warn] Cannot open %s\n", word_path);
-                    g_free(word_path);
-                    continue;
-                }
+static void write_gridl_file(const char *root_dir, const GString *text, int max_row, int max_col)
+{
+    char *gridl_path = root_dir ? g_build_filename(root_dir, "GRIDL", NULL) : g_strdup("GRIDL");
+    GError *err = NULL;
+    if (g_file_set_contents(gridl_path, text->str, -1, &err)) {
+        trace_count(TRACE_FILES, 1);
+        g_print("[Info] GRIDL file updated (%dx%d) -> %s\n", max_col, max_row, gridl_path);
+    } else {
+        g_printerr("[Error] GRIDL write failed (%s): %s\n", gridl_path, err->message);
+        g_clear_error(&err);
+    }
+    g_free(gridl_path);
+}
 
-                GPtrArray *letters = g_ptr_array_new_with_free_func(g_free);
-                const char *lname = NULL;
-                while ((lname = g_dir_read_name(letters_dir)) != NULL) {
-                    if (g_str_has_prefix(lname, "letter_"))
-                        g_ptr_array_add(letters, g_strdup(lname));
-                }
-                g_dir_close(letters_dir);
-
-                qsort(letters->pdata, letters->len, sizeof(gpointer), cmp_str_ptr);
-                GString *word_line = g_string_new("");
-                for (guint li = 0; li < letters->len; li++) {
-                    char *lpath = g_build_filename(word_path, (char *)g_ptr_array_index(letters, li), NULL);
-                    char letter = predict_letter_for_cell(&net, lpath);
-                    g_string_append_c(word_line, letter);
-                    g_free(lpath);
-                }
-                g_ptr_array_free(letters, TRUE);
-                g_free(word_path);
+static void write_gridwo_file(const char *root_dir, const GString *text)
+{
+    if (text->len == 0) g_printerr("[Warn] No word letter detected, GRIDWO empty.\n");
 
-                g_string_append(out_words, word_line->str);
-                g_string_append_c(out_words, '\n');
-                g_string_free(word_line, TRUE);
-            }
+    char *gridwo_path = g_build_filename(root_dir, "GRIDWO", NULL);
+    GError *err = NULL;
+    if (g_file_set_contents(gridwo_path, text->str, -1, &err)) {
+        trace_count(TRACE_FILES, 1);
+        g_print("[Info] GRIDWO file generated -> %s\n", gridwo_path);
+    } else {
+        g_printerr("[Error] GRIDWO write failed (%s): %s\n", gridwo_path, err->message);
+        g_clear_error(&err);
+    }
+    g_free(gridwo_path);
+}
 
-            char *gridwo_path = g_build_filename(root_dir, "GRIDWO", NULL);
-            GError *err = NULL;
-            if (g_file_set_contents(gridwo_path, out_words->str, -1, &err))
-                g_print("[Info] GRIDWO file generated -> %s\n", gridwo_path);
-            else {
-                g_printerr("[Error] GRIDWO write failed (%s): %s\n", gridwo_path, err->message);
-                g_clear_error(&err);
-            }
-            g_free(gridwo_path);
-            g_string_free(out_words, TRUE);
-        }
-        g_ptr_array_free(word_names, TRUE);
+// Writes GRIDL + CELLPOS (when bbox is known) from the letters predicted for
+// the grid glyphs. Returns the number of recognized cells (0 on error).
+static int recognize_grid_cells(const char *root_dir, const GlyphBuffer *glyphs,
+                                const char *letters, const int bbox[4])
+{
+    GString *text = g_string_new("");
+    int max_row = 0, max_col = 0;
+    int nb_cells = build_gridl_text(glyphs, letters, text, &max_row, &max_col);
+    if (nb_cells == 0) {
+        g_printerr("[Error] No grid letter detected\n");
+    } else {
+        write_gridl_file(root_dir, text, max_row, max_col);
+        write_cell_positions(root_dir, max_row, max_col, bbox);
     }
-    g_free(words_dir);
+    g_string_free(text, TRUE);
+    return nb_cells;
+}
+
+// Writes GRIDWO from the letters predicted for the word glyphs.
+static void recognize_word_letters(const char *root_dir, const GlyphBuffer *glyphs, const char *letters)
+{
+    GString *text = g_string_new("");
+    build_gridwo_text(glyphs, letters, text);
+    write_gridwo_file(root_dir, text);
+    g_string_free(text, TRUE);
+}
+
+static void run_solver_pipeline(void)
+{
+    const char *root_dir = ".";
+    const int bbox[4] = { g_grid_x0, g_grid_y0, g_grid_x1, g_grid_y1 };
+
+    // loaded on the first Solve, then kept for the next puzzles
+    char *letters = classify_glyphs(model_get(), &g_glyphs);
+    int ok = recognize_grid_cells(root_dir, &g_glyphs, letters, g_grid_bbox_set ? bbox : NULL) > 0;
+    if (ok) recognize_word_letters(root_dir, &g_glyphs, letters);
+    g_free(letters);
+    if (!ok) return;
 
     GPtrArray *results = NULL;
     int nb_rows = 0, nb_cols = 0;
@@ -909,9 +1022,6 @@ static void run_solver_pipeline(void)
             g_ptr_array_free(results, TRUE);
         }
     }
-
-    cleanup(&net);
-    g_free(root_dir);
 }
 
 typedef struct
@@ -920,13 +1030,15 @@ typedef struct
     double avg;
 } Segment;
 
-static void find_zones(GdkPixbuf *pix,
+static void find_zones(const GrayImage *gray,
                        int *gx0,int *gx1,int *gy0,int *gy1,
                        int *wx0,int *wx1,int *wy0,int *wy1)
 {
+    TRACE_SCOPE("find_zones");
     const guint8 thr = 180;
-    int W = gdk_pixbuf_get_width(pix);
-    int H = gdk_pixbuf_get_height(pix);
+    int W = gray->w;
+    int H = gray->h;
+    trace_count(TRACE_PIXELS, (gint64)W * H);
 
     int gx0_local = 0, gx1_local = 0;
     int gy0_local = 0, gy1_local = H - 1;
@@ -937,14 +1049,12 @@ static void find_zones(GdkPixbuf *pix,
     if (W <= 0 || H <= 0) { goto fallback_zones; }
 
     double *dens = calloc((size_t)W, sizeof(double));
-    if (!dens) { goto fallback_zones; }
+    int *black = malloc(sizeof(int) * (size_t)W);
+    if (!dens || !black) { free(dens); free(black); goto fallback_zones; }
+    gray_ink_profiles(gray, thr, 0, W - 1, 0, H - 1, black, NULL);
     for (int x = 0; x < W; x++)
-    {
-        int black = 0;
-        for (int y = 0; y < H; y++)
-            if (get_gray_local(pix, x, y) < thr) black++;
-        dens[x] = (double)black / (double)H;
-    }
+        dens[x] = (double)black[x] / (double)H;
+    free(black);
 
     double *sm = calloc((size_t)W, sizeof(double));
     if (!sm) { free(dens); goto fallback_zones; }
@@ -1024,15 +1134,12 @@ static void find_zones(GdkPixbuf *pix,
         gx1_local = seg[grid_idx].end;
 
         double *row_dens = calloc((size_t)H, sizeof(double));
-        if (row_dens)
+        int *row_black = malloc(sizeof(int) * (size_t)H);
+        if (row_dens && row_black)
         {
+            gray_ink_profiles(gray, thr, gx0_local, gx1_local, 0, H - 1, NULL, row_black);
             for (int y = 0; y < H; y++)
-            {
-                int black = 0;
-                for (int x = gx0_local; x <= gx1_local; x++)
-                    if (get_gray_local(pix, x, y) < thr) black++;
-                row_dens[y] = (double)black / (double)(gx1_local - gx0_local + 1);
-            }
+                row_dens[y] = (double)row_black[y] / (double)(gx1_local - gx0_local + 1);
 
             double maxr = 0.0;
             for (int y = 0; y < H; y++) if (row_dens[y] > maxr) maxr = row_dens[y];
@@ -1042,8 +1149,9 @@ static void find_zones(GdkPixbuf *pix,
             while (top < H && row_dens[top] < Ty) top++;
             while (bot >= 0 && row_dens[bot] < Ty) bot--;
             if (top < bot) { gy0_local = top; gy1_local = bot; }
-            free(row_dens);
         }
+        free(row_dens);
+        free(row_black);
     }
     else { goto fallback_zones; }
 
@@ -1124,9 +1232,20 @@ static void run_detection(GtkWidget *win,const char *path)
         return;
     }
 
+    PageGray pg;
+    page_gray_init(&pg);
+    if(!page_gray_load(&pg,img))
+    {
+        g_printerr("Error: unsupported image format: %s\n",path);
+        page_gray_free(&pg);
+        g_object_unref(img);
+        return;
+    }
+    page_gray_binarize(&pg);
+
     GdkPixbuf *disp=gdk_pixbuf_copy(img);
     int gx0,gx1,gy0,gy1, wx0,wx1,wy0,wy1;
-    find_zones(img,&gx0,&gx1,&gy0,&gy1,&wx0,&wx1,&wy0,&wy1);
+    find_zones(&pg.avg,&gx0,&gx1,&gy0,&gy1,&wx0,&wx1,&wy0,&wy1);
 
     g_grid_x0 = gx0; g_grid_y0 = gy0; g_grid_x1 = gx1; g_grid_y1 = gy1;
     g_grid_bbox_set = 1;
@@ -1137,9 +1256,14 @@ static void run_detection(GtkWidget *win,const char *path)
     draw_rect(disp,gx0,gy0,gx1,gy1,255,0,0);
     draw_rect(disp,wx0,wy0,wx1,wy1,0,255,0);
 
+    glyph_buffer_free(&g_glyphs);
+    glyph_buffer_init(&g_glyphs);
+
     const guint8 BLACK_T=160;
-    detect_letters_in_grid(img,disp,gx0,gx1,gy0,gy1,BLACK_T,0,128,255);
-    detect_letters_in_words(img,disp,wx0,wx1,wy0,wy1,BLACK_T,0,128,255);
+    detect_letters_in_grid(img,&pg.avg,disp,&g_glyphs,gx0,gx1,gy0,gy1,BLACK_T,0,128,255);
+    detect_letters_in_words(img,&pg.luma,disp,&g_glyphs,wx0,wx1,wy0,wy1,BLACK_T,0,128,255);
+    page_gray_free(&pg);
+    if (g_glyphs.dump) glyph_buffer_dump(&g_glyphs, ".");
 
     GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 8);
     gtk_container_add(GTK_CONTAINER(win), box);
@@ -1175,4 +1299,514 @@ int detection_run_app(int argc,char **argv)
     int status=g_application_run(G_APPLICATION(app),argc,argv);
     g_object_unref(app);
     return status;
-}
\ No newline at end of file
+}
+// --------------------------------------------------
+// Headless pipeline (batch and serve: no GTK main loop, no display)
+// --------------------------------------------------
+static const char *STAGE_NAMES[DETECT_STAGE_COUNT] = {
+    "decode", "deskew", "binarize", "find_zones", "grid_letters", "word_letters", "recognize", "solve"
+};
+
+const char *detection_stage_name(int stage)
+{
+    return stage >= 0 && stage < DETECT_STAGE_COUNT ? STAGE_NAMES[stage] : "?";
+}
+
+void detection_options_init(DetectionOptions *opt)
+{
+    opt->deskew = FALSE;
+    opt->skew_method = SKEW_HOUGH;
+    opt->bin = bin_method_from_env();
+    opt->dump_glyphs = FALSE;
+}
+
+int detection_parse_options(int argc, char **argv, int first, DetectionOptions *opt)
+{
+    while (first < argc && strncmp(argv[first], "--", 2) == 0) {
+        if (strcmp(argv[first], "--dump-glyphs") == 0) {
+            opt->dump_glyphs = TRUE;
+            first++;
+        } else if (strcmp(argv[first], "--deskew") == 0) {
+            if (first + 1 >= argc || !skew_method_from_string(argv[first + 1], &opt->skew_method))
+                return -1;
+            opt->deskew = TRUE;
+            first += 2;
+        } else if (strcmp(argv[first], "--binarize") == 0) {
+            if (first + 1 >= argc || !bin_method_from_string(argv[first + 1], &opt->bin))
+                return -1;
+            first += 2;
+        } else {
+            break;
+        }
+    }
+    return first;
+}
+
+// Everything one page gives, kept in memory.
+typedef struct
+{
+    SkewResult skew;        // when opt->deskew
+    gint64 skew_us;
+    int bbox[4];            // grid zone: x0, y0, x1, y1
+    int cells;              // recognized grid cells, 0 = no grid
+    int rows, cols;
+    GString *gridl;         // GRIDL contents
+    GString *gridwo;        // GRIDWO contents
+    GPtrArray *solutions;   // SolveResult, one per word of gridwo
+} PageResult;
+
+// One page on its way through the headless stages, with its own buffers:
+// pages in different stages never share anything.
+typedef struct
+{
+    GdkPixbuf *img;         // deskewed copy once rotated, dropped after segmentation
+    PageGray pg;            // released after segmentation too
+    GlyphBuffer glyphs;
+    PageResult res;
+    gint64 stage_us[DETECT_STAGE_COUNT];
+} PageWork;
+
+static void page_work_init(PageWork *pw)
+{
+    memset(pw, 0, sizeof(*pw));
+    page_gray_init(&pw->pg);
+    glyph_buffer_init(&pw->glyphs);
+    pw->res.gridl = g_string_new("");
+    pw->res.gridwo = g_string_new("");
+}
+
+// Ready for the next page; glyph and text buffers are kept.
+static void page_work_reset(PageWork *pw)
+{
+    if (pw->img) g_object_unref(pw->img);
+    pw->img = NULL;
+    page_gray_free(&pw->pg);
+    glyph_buffer_clear(&pw->glyphs);
+    GString *gridl = pw->res.gridl, *gridwo = pw->res.gridwo;
+    if (pw->res.solutions) g_ptr_array_free(pw->res.solutions, TRUE);
+    memset(&pw->res, 0, sizeof(pw->res));
+    pw->res.gridl = g_string_truncate(gridl, 0);
+    pw->res.gridwo = g_string_truncate(gridwo, 0);
+    memset(pw->stage_us, 0, sizeof(pw->stage_us));
+}
+
+static void page_work_free(PageWork *pw)
+{
+    page_work_reset(pw);
+    g_string_free(pw->res.gridl, TRUE);
+    g_string_free(pw->res.gridwo, TRUE);
+    glyph_buffer_free(&pw->glyphs);
+}
+
+static void stage_done(gint64 stage_us[DETECT_STAGE_COUNT], int stage, gint64 *t)
+{
+    gint64 now = g_get_monotonic_time();
+    stage_us[stage] += now - *t;
+    *t = now;
+}
+
+// Stages of the headless pipeline. They print nothing and touch no global
+// state, so pages can be in different stages on different threads.
+
+// decode: the gray planes of a decoded page
+static gboolean page_load(PageWork *pw, GdkPixbuf *img)
+{
+    gint64 t = g_get_monotonic_time();
+    pw->img = g_object_ref(img);
+    gboolean ok = page_gray_load(&pw->pg, img);
+    stage_done(pw->stage_us, DETECT_STAGE_DECODE, &t);
+    return ok;
+}
+
+// deskew + binarize
+static void page_preprocess(PageWork *pw, const DetectionOptions *opt)
+{
+    PageGray *pg = &pw->pg;
+    gint64 t = g_get_monotonic_time();
+    if (opt->deskew) {
+        pw->res.skew = skew_estimate(&pg->avg, opt->skew_method, g_getenv("OCR_SKEW_THIN") != NULL);
+        pw->res.skew_us = g_get_monotonic_time() - t;
+        if (fabs(pw->res.skew.angle) >= 0.05) {
+            // On allocation failure the page is kept unrotated.
+            GdkPixbuf *rotated = rotate_pixbuf(pw->img, pw->res.skew.angle, ROTATE_BILINEAR);
+            if (rotated) {
+                g_object_unref(pw->img);
+                pw->img = rotated;
+                page_gray_rotate(pg, pw->res.skew.angle);
+            }
+        }
+        stage_done(pw->stage_us, DETECT_STAGE_DESKEW, &t);
+    }
+    pg->bin = opt->bin;
+    if (pg->bin != BIN_NONE) {
+        page_gray_binarize(pg);
+        stage_done(pw->stage_us, DETECT_STAGE_BINARIZE, &t);
+    }
+}
+
+// zones, then grid and word letters into pw->glyphs
+static void page_segment(PageWork *pw)
+{
+    PageGray *pg = &pw->pg;
+    GdkPixbuf *disp = gdk_pixbuf_copy(pw->img);
+    gint64 t = g_get_monotonic_time();
+
+    int gx0, gx1, gy0, gy1, wx0, wx1, wy0, wy1;
+    find_zones(&pg->avg, &gx0, &gx1, &gy0, &gy1, &wx0, &wx1, &wy0, &wy1);
+    int *bbox = pw->res.bbox;
+    bbox[0] = gx0; bbox[1] = gy0; bbox[2] = gx1; bbox[3] = gy1;
+    stage_done(pw->stage_us, DETECT_STAGE_ZONES, &t);
+
+    const guint8 BLACK_T = 160;
+    detect_letters_in_grid(pw->img, &pg->avg, disp, &pw->glyphs, gx0, gx1, gy0, gy1, BLACK_T, 0, 128, 255);
+    stage_done(pw->stage_us, DETECT_STAGE_GRID, &t);
+
+    detect_letters_in_words(pw->img, &pg->luma, disp, &pw->glyphs, wx0, wx1, wy0, wy1, BLACK_T, 0, 128, 255);
+    stage_done(pw->stage_us, DETECT_STAGE_WORDS, &t);
+
+    // Recognition and solving only read the glyphs: a page waiting for them
+    // holds no page-sized buffer.
+    g_object_unref(pw->img);
+    g_object_unref(disp);
+    pw->img = NULL;
+    page_gray_free(pg);
+}
+
+// GRIDL / GRIDWO contents. FALSE when no grid letter was found.
+static gboolean page_recognize(PageWork *pw, const OcrModel *model)
+{
+    gint64 t = g_get_monotonic_time();
+    char *letters = classify_glyphs(model, &pw->glyphs);
+    PageResult *res = &pw->res;
+    res->cells = build_gridl_text(&pw->glyphs, letters, res->gridl, &res->rows, &res->cols);
+    if (res->cells > 0) build_gridwo_text(&pw->glyphs, letters, res->gridwo);
+    g_free(letters);
+    stage_done(pw->stage_us, DETECT_STAGE_RECOGNIZE, &t);
+    return res->cells > 0;
+}
+
+static gboolean page_solve(PageWork *pw)
+{
+    gint64 t = g_get_monotonic_time();
+    Grid grille;
+    if (CreaMatriceTexte(pw->res.gridl->str, &grille) <= 0) return FALSE;
+    pw->res.solutions = solve_words(&grille, pw->res.gridwo->str);
+    grid_free(&grille);
+    stage_done(pw->stage_us, DETECT_STAGE_SOLVE, &t);
+    return TRUE;
+}
+
+// Every stage after decode, on one thread. Returns 0 when no grid letter was found.
+static int process_page(PageWork *pw, const DetectionOptions *opt, const OcrModel *model)
+{
+    page_preprocess(pw, opt);
+    page_segment(pw);
+    return page_recognize(pw, model) && page_solve(pw);
+}
+
+// --------------------------------------------------
+// Batch: one thread group per stage, pages streamed through them
+// --------------------------------------------------
+typedef struct
+{
+    PageWork work;
+    char *error;           // decode failure, reported by the sink
+    gboolean ok;
+} BatchJob;
+
+typedef struct
+{
+    const DetectionOptions *opt;
+    const OcrModel *model;
+    char **paths;
+    int nb_images, nb_ok, nb_failed;
+    gint64 total_us[DETECT_STAGE_COUNT];
+} BatchRun;
+
+static void batch_decode(void *job, int item, void *ctx)
+{
+    BatchJob *bj = job;
+    BatchRun *run = ctx;
+    const char *path = run->paths[item];
+    page_work_reset(&bj->work);
+    g_free(bj->error);
+    bj->error = NULL;
+    bj->ok = FALSE;
+
+    TRACE_SCOPE("decode");
+    gint64 t = g_get_monotonic_time();
+    GError *err = NULL;
+    GdkPixbuf *img = gdk_pixbuf_new_from_file(path, &err);
+    if (!img) {
+        bj->error = g_strdup_printf("%s: %s", path, err->message);
+        g_clear_error(&err);
+        return;
+    }
+    bj->work.stage_us[DETECT_STAGE_DECODE] = g_get_monotonic_time() - t;
+    bj->ok = page_load(&bj->work, img);
+    g_object_unref(img);
+    if (!bj->ok) bj->error = g_strdup_printf("%s: unsupported image format", path);
+}
+
+static void batch_preprocess(void *job, int item, void *ctx)
+{
+    (void)item;
+    BatchJob *bj = job;
+    if (bj->ok) page_preprocess(&bj->work, ((BatchRun *)ctx)->opt);
+}
+
+static void batch_segment(void *job, int item, void *ctx)
+{
+    (void)item; (void)ctx;
+    BatchJob *bj = job;
+    if (bj->ok) page_segment(&bj->work);
+}
+
+static void batch_recognize(void *job, int item, void *ctx)
+{
+    (void)item;
+    BatchJob *bj = job;
+    if (bj->ok) bj->ok = page_recognize(&bj->work, ((BatchRun *)ctx)->model);
+}
+
+static void batch_solve(void *job, int item, void *ctx)
+{
+    (void)item; (void)ctx;
+    BatchJob *bj = job;
+    if (bj->ok) bj->ok = page_solve(&bj->work);
+}
+
+// Same output as the GUI Solve button, in input order: GRIDL, CELLPOS and
+// GRIDWO in the current directory, [SOLVE] lines on stdout.
+static void batch_report(void *job, int item, void *ctx)
+{
+    BatchJob *bj = job;
+    BatchRun *run = ctx;
+    const char *path = run->paths[item];
+    PageResult *res = &bj->work.res;
+    g_print("[Batch] (%d/%d) %s\n", item + 1, run->nb_images, path);
+
+    if (bj->error) {
+        g_printerr("[Error] %s\n", bj->error);
+    } else {
+        if (run->opt->deskew)
+            g_print("[Deskew] %s: %.1f deg (confidence %.2f) in %.1f ms\n",
+                    skew_method_name(run->opt->skew_method), res->skew.angle, res->skew.confidence,
+                    res->skew_us / 1000.0);
+        if (run->opt->dump_glyphs || bj->work.glyphs.dump) glyph_buffer_dump(&bj->work.glyphs, ".");
+
+        if (res->cells == 0) {
+            g_printerr("[Error] No grid letter detected\n");
+        } else {
+            write_gridl_file(".", res->gridl, res->rows, res->cols);
+            write_cell_positions(".", res->rows, res->cols, res->bbox);
+            write_gridwo_file(".", res->gridwo);
+        }
+        if (res->solutions) print_solve_results(res->solutions);
+    }
+
+    if (bj->ok) run->nb_ok++;
+    else run->nb_failed++;
+    gint64 image_us = 0;
+    for (int s = 0; s < DETECT_STAGE_COUNT; s++) {
+        run->total_us[s] += bj->work.stage_us[s];
+        image_us += bj->work.stage_us[s];
+    }
+    g_print("[Batch] %s: %s in %.1f ms\n", path, bj->ok ? "done" : "FAILED", image_us / 1000.0);
+}
+
+// Peak bytes per pixel of a page between decode and the end of segmentation:
+// the RGB(A) pixbuf, its rotated and annotated copies, three gray planes.
+#define PAGE_BYTES_PER_PIXEL 16
+
+// At most max_jobs, and no more pages than fit in half the physical memory,
+// sized on the first image the loaders can read.
+static int batch_jobs_for_memory(char **paths, int nb_paths, int max_jobs)
+{
+    size_t budget = workers_memory() / 2;
+    if (budget == 0) return max_jobs;
+    for (int i = 0; i < nb_paths; i++) {
+        int w, h;
+        if (!gdk_pixbuf_get_file_info(paths[i], &w, &h) || w <= 0 || h <= 0) continue;
+        size_t fit = budget / ((size_t)w * (size_t)h * PAGE_BYTES_PER_PIXEL);
+        if (fit < 1) fit = 1;
+        return fit < (size_t)max_jobs ? (int)fit : max_jobs;
+    }
+    return max_jobs;
+}
+
+int detection_run_batch(int argc, char **argv)
+{
+    DetectionOptions opt;
+    detection_options_init(&opt);
+    int first = detection_parse_options(argc, argv, 1, &opt);
+    gboolean bad = first < 0 || first >= argc;
+    for (int i = first; !bad && i < argc; i++)
+        if (strncmp(argv[i], "--", 2) == 0) bad = TRUE;   // unknown or misplaced option
+    if (bad) {
+        printf("Usage: ./ocr_project batch [--dump-glyphs] [--deskew hough|profile] [--binarize otsu|sauvola] <image> [image...]\n");
+        return 1;
+    }
+
+    gint64 t = g_get_monotonic_time();
+    const OcrModel *model = model_get();
+    gint64 load_us = g_get_monotonic_time() - t;
+
+    // Decode, preprocessing and segmentation share the cores; recognition
+    // already spreads each page over the worker pool, solving is short.
+    int wide = workers_count() / 2;
+    if (wide < 1) wide = 1;
+    const PipeStage stages[] = {
+        { batch_decode, wide },
+        { batch_preprocess, wide },
+        { batch_segment, wide },
+        { batch_recognize, 1 },
+        { batch_solve, 1 },
+    };
+    int nb_stages = (int)G_N_ELEMENTS(stages);
+    int nb_jobs = 0;
+    for (int s = 0; s < nb_stages; s++) nb_jobs += stages[s].threads;
+    nb_jobs = MIN(nb_jobs + 2, argc - first);   // a page waiting before each busy stage
+    int mem_jobs = batch_jobs_for_memory(argv + first, argc - first, nb_jobs);
+    if (mem_jobs < nb_jobs) {
+        g_printerr("[Info] %d pages in flight instead of %d to fit in memory\n", mem_jobs, nb_jobs);
+        nb_jobs = mem_jobs;
+    }
+
+    BatchJob *jobs = g_malloc0(sizeof(BatchJob) * nb_jobs);
+    void **job_ptrs = g_malloc(sizeof(void *) * nb_jobs);
+    for (int j = 0; j < nb_jobs; j++) {
+        page_work_init(&jobs[j].work);
+        job_ptrs[j] = &jobs[j];
+    }
+
+    BatchRun run = { &opt, model, argv + first, argc - first, 0, 0, {0} };
+    t = g_get_monotonic_time();
+    pipeline_run(job_ptrs, nb_jobs, run.nb_images, stages, nb_stages, batch_report, &run);
+    gint64 wall_us = g_get_monotonic_time() - t;
+
+    for (int j = 0; j < nb_jobs; j++) {
+        page_work_free(&jobs[j].work);
+        g_free(jobs[j].error);
+    }
+    g_free(job_ptrs);
+    g_free(jobs);
+
+    int nb_images = run.nb_images;
+    gint64 all_us = 0;
+    printf("\n--- BATCH SUMMARY (%d images, %d ok, %d failed) ---\n", nb_images, run.nb_ok, run.nb_failed);
+    printf("%-14s %12s %12s\n", "stage", "total ms", "avg ms");
+    printf("%-14s %12.1f %12s\n", "model_load", load_us / 1000.0, "-");
+    for (int s = 0; s < DETECT_STAGE_COUNT; s++) {
+        printf("%-14s %12.1f %12.2f\n", STAGE_NAMES[s],
+               run.total_us[s] / 1000.0, run.total_us[s] / 1000.0 / nb_images);
+        all_us += run.total_us[s];
+    }
+    printf("%-14s %12.1f %12.2f\n", "all", all_us / 1000.0, all_us / 1000.0 / nb_images);
+    // below "all" when the stages of consecutive images overlapped
+    printf("%-14s %12.1f %12.2f\n", "wall", wall_us / 1000.0, wall_us / 1000.0 / nb_images);
+
+    return run.nb_failed == 0 ? 0 : 1;
+}
+
+// --------------------------------------------------
+// In-memory solving for the server
+// --------------------------------------------------
+struct DetectionWorker
+{
+    DetectionOptions opt;
+    PageWork work;
+};
+
+DetectionWorker *detection_worker_new(const DetectionOptions *opt)
+{
+    DetectionWorker *w = g_malloc0(sizeof(DetectionWorker));
+    w->opt = *opt;
+    page_work_init(&w->work);
+    w->work.glyphs.dump = 0;   // concurrent pages would overwrite each other's dumps
+    return w;
+}
+
+void detection_worker_free(DetectionWorker *w)
+{
+    if (!w) return;
+    page_work_free(&w->work);
+    g_free(w);
+}
+
+static void json_append_string(GString *out, const char *s)
+{
+    g_string_append_c(out, '"');
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            g_string_append_c(out, '\\');
+            g_string_append_c(out, (char)c);
+        } else if (c < 0x20) {
+            g_string_append_printf(out, "\\u%04x", c);
+        } else {
+            g_string_append_c(out, (char)c);
+        }
+    }
+    g_string_append_c(out, '"');
+}
+
+// One JSON string per non-empty line of text.
+static void json_append_lines(GString *out, const char *text)
+{
+    g_string_append_c(out, '[');
+    gboolean first = TRUE;
+    while (*text) {
+        size_t len = strcspn(text, "\n");
+        if (len > 0) {
+            if (!first) g_string_append_c(out, ',');
+            char *line = g_strndup(text, len);
+            json_append_string(out, line);
+            g_free(line);
+            first = FALSE;
+        }
+        text += len;
+        if (*text) text++;
+    }
+    g_string_append_c(out, ']');
+}
+
+char *detection_worker_solve_json(DetectionWorker *w, GdkPixbuf *img,
+                                  gint64 stage_us[DETECT_STAGE_COUNT])
+{
+    PageWork *pw = &w->work;
+    page_work_reset(pw);
+    GString *out = g_string_new("");
+    if (!page_load(pw, img))
+        g_string_append(out, "{\"ok\":false,\"error\":\"unsupported image format\"}");
+    else if (!process_page(pw, &w->opt, model_get()))
+        g_string_append(out, "{\"ok\":false,\"error\":\"no grid letter detected\"}");
+    for (int s = 0; s < DETECT_STAGE_COUNT; s++) stage_us[s] += pw->stage_us[s];
+    if (out->len > 0) {
+        page_work_reset(pw);
+        return g_string_free(out, FALSE);
+    }
+
+    const PageResult *res = &pw->res;
+    g_string_append_printf(out, "{\"ok\":true,\"rows\":%d,\"cols\":%d,\"gridl\":",
+                           res->rows, res->cols);
+    json_append_lines(out, res->gridl->str);
+    g_string_append(out, ",\"gridwo\":");
+    json_append_lines(out, res->gridwo->str);
+    g_string_append(out, ",\"solutions\":[");
+    for (guint i = 0; i < res->solutions->len; i++) {
+        const SolveResult *sr = g_ptr_array_index(res->solutions, i);
+        if (i > 0) g_string_append_c(out, ',');
+        g_string_append(out, "{\"word\":");
+        json_append_string(out, sr->word);
+        if (sr->found)
+            g_string_append_printf(out, ",\"found\":true,\"start\":{\"col\":%d,\"row\":%d},"
+                                   "\"end\":{\"col\":%d,\"row\":%d}}",
+                                   sr->c1, sr->r1, sr->c2, sr->r2);
+        else
+            g_string_append(out, ",\"found\":false}");
+    }
+    g_string_append(out, "]}");
+    page_work_reset(pw);
+    return g_string_free(out, FALSE);
+}
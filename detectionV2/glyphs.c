@@ -0,0 +1,134 @@
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "glyphs.h"
+#include "trace.h"
+
+void glyph_buffer_init(GlyphBuffer *buf)
+{
+    const char *env = g_getenv("OCR_DUMP_GLYPHS");
+    buf->items = NULL;
+    buf->len = 0;
+    buf->cap = 0;
+    buf->dump = (env && env[0] && strcmp(env, "0") != 0);
+}
+
+void glyph_buffer_clear(GlyphBuffer *buf)
+{
+    buf->len = 0;
+}
+
+void glyph_buffer_free(GlyphBuffer *buf)
+{
+    g_free(buf->items);
+    buf->items = NULL;
+    buf->len = 0;
+    buf->cap = 0;
+}
+
+void glyph_buffer_truncate(GlyphBuffer *buf, int len)
+{
+    if (len >= 0 && len < buf->len) buf->len = len;
+}
+
+Glyph *glyph_buffer_push(GlyphBuffer *buf, const GdkPixbuf *tile)
+{
+    if (gdk_pixbuf_get_width(tile) != GLYPH_W || gdk_pixbuf_get_height(tile) != GLYPH_H)
+        return NULL;
+
+    if (buf->len == buf->cap) {
+        buf->cap = buf->cap ? buf->cap * 2 : 256;
+        buf->items = g_realloc(buf->items, (gsize)buf->cap * sizeof(Glyph));
+    }
+    Glyph *g = &buf->items[buf->len++];
+
+    int n  = gdk_pixbuf_get_n_channels(tile);
+    int rs = gdk_pixbuf_get_rowstride(tile);
+    const guchar *px = gdk_pixbuf_get_pixels(tile);
+    gboolean alpha = gdk_pixbuf_get_has_alpha(tile);
+
+    for (int y = 0; y < GLYPH_H; y++) {
+        const guchar *row = px + y * rs;
+        for (int x = 0; x < GLYPH_W; x++) {
+            const guchar *p = row + x * n;
+            int gray = (p[0] + p[1] + p[2]) / 3;
+            if (alpha) gray = (gray * p[3] + 255 * (255 - p[3])) / 255;
+            g->pixels[y * GLYPH_W + x] = (guint8)gray;
+        }
+    }
+
+    g->col = 0; g->row = 0;
+    g->word = -1; g->letter = -1;
+    g->idx = 0;
+    return g;
+}
+
+static void remove_tree_contents(const char *path)
+{
+    GDir *dir = g_dir_open(path, 0, NULL);
+    if (!dir) return;
+
+    const char *name = NULL;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        char *child = g_build_filename(path, name, NULL);
+        if (g_file_test(child, G_FILE_TEST_IS_DIR)) {
+            remove_tree_contents(child);
+            (void)rmdir(child);
+        } else {
+            (void)unlink(child);
+        }
+        g_free(child);
+    }
+    g_dir_close(dir);
+}
+
+void glyph_buffer_dump(const GlyphBuffer *buf, const char *root_dir)
+{
+    char *cells_dir = g_build_filename(root_dir, "cells", NULL);
+    char *words_dir = g_build_filename(root_dir, "letterInWord", NULL);
+    remove_tree_contents(cells_dir);
+    remove_tree_contents(words_dir);
+    g_mkdir_with_parents(cells_dir, 0755);
+    g_mkdir_with_parents(words_dir, 0755);
+
+    GdkPixbuf *out = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, GLYPH_W, GLYPH_H);
+    int rs = gdk_pixbuf_get_rowstride(out);
+    guchar *px = gdk_pixbuf_get_pixels(out);
+
+    for (int i = 0; i < buf->len; i++) {
+        const Glyph *g = &buf->items[i];
+        for (int y = 0; y < GLYPH_H; y++)
+            for (int x = 0; x < GLYPH_W; x++) {
+                guchar *p = px + y * rs + x * 3;
+                p[0] = p[1] = p[2] = g->pixels[y * GLYPH_W + x];
+            }
+
+        char name[64];
+        char *path;
+        if (g->word < 0) {
+            snprintf(name, sizeof(name), "%03d_%03d_%04d.png", g->col, g->row, g->idx);
+            path = g_build_filename(cells_dir, name, NULL);
+        } else {
+            char word_name[32];
+            snprintf(word_name, sizeof(word_name), "word_%03d", g->word);
+            char *word_dir = g_build_filename(words_dir, word_name, NULL);
+            g_mkdir_with_parents(word_dir, 0755);
+            snprintf(name, sizeof(name), "letter_%03d.png", g->letter);
+            path = g_build_filename(word_dir, name, NULL);
+            g_free(word_dir);
+        }
+        if (gdk_pixbuf_save(out, path, "png", NULL, NULL))
+            trace_count(TRACE_FILES, 1);
+        else
+            fprintf(stderr, "[glyphs] Save failed %s\n", path);
+        g_free(path);
+    }
+
+    g_object_unref(out);
+    g_free(cells_dir);
+    g_free(words_dir);
+    g_print("[Info] %d glyphs dumped under %s\n", buf->len, root_dir);
+}
@@ -0,0 +1,37 @@
+#ifndef GLYPHS_H
+#define GLYPHS_H
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+// Normalized letter tiles handed from detection to recognition.
+#define GLYPH_W 48
+#define GLYPH_H 48
+
+typedef struct
+{
+    guint8 pixels[GLYPH_W * GLYPH_H]; // gray, row-major, 0 = ink, 255 = paper
+    int col, row;      // grid cell (1-based), 0 for word letters
+    int word, letter;  // word band and position in it, -1 for grid cells
+    int idx;           // detection order inside the grid or the word
+} Glyph;
+
+typedef struct
+{
+    Glyph *items;
+    int len, cap;
+    int dump;          // debug: also write cells/ and letterInWord/ PNGs
+} GlyphBuffer;
+
+// dump defaults to the OCR_DUMP_GLYPHS environment variable.
+void glyph_buffer_init(GlyphBuffer *buf);
+void glyph_buffer_clear(GlyphBuffer *buf);
+void glyph_buffer_free(GlyphBuffer *buf);
+void glyph_buffer_truncate(GlyphBuffer *buf, int len);
+
+// Appends a tile built from a GLYPH_W x GLYPH_H pixbuf (alpha is composited on white).
+Glyph *glyph_buffer_push(GlyphBuffer *buf, const GdkPixbuf *tile);
+
+// Debug dump in the legacy on-disk layout under root_dir.
+void glyph_buffer_dump(const GlyphBuffer *buf, const char *root_dir);
+
+#endif
@@ -0,0 +1,242 @@
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <string.h>
+#include "grayimage.h"
+
+void gray_image_init(GrayImage *g)
+{
+    memset(g, 0, sizeof(*g));
+}
+
+void gray_image_free(GrayImage *g)
+{
+    if (g->ink) {
+        for (int i = 0; i < GRAY_INK_TABLES; i++) g_free(g->ink->t[i].sum);
+        g_free(g->ink);
+    }
+    g_free(g->data);
+    memset(g, 0, sizeof(*g));
+}
+
+void gray_image_resize(GrayImage *g, int w, int h)
+{
+    gsize size = (gsize)w * (gsize)h;
+    if (size > g->cap) {
+        g_free(g->data);
+        g->data = g_malloc(size);
+        g->cap = size;
+    }
+    g->w = w;
+    g->h = h;
+    g->binary = FALSE;
+
+    if (!g->ink) g->ink = g_malloc0(sizeof(InkCache));
+    for (int i = 0; i < GRAY_INK_TABLES; i++) g->ink->t[i].thr = -1;
+}
+
+gboolean gray_image_from_pixbuf(GrayImage *g, const GdkPixbuf *pix, GrayMode mode)
+{
+    if (!pix) return FALSE;
+    int W = gdk_pixbuf_get_width(pix);
+    int H = gdk_pixbuf_get_height(pix);
+    int n = gdk_pixbuf_get_n_channels(pix);
+    int rs = gdk_pixbuf_get_rowstride(pix);
+    const guchar *px = gdk_pixbuf_get_pixels(pix);
+    if (W <= 0 || H <= 0 || n < 3) return FALSE;
+
+    gray_image_resize(g, W, H);
+
+    for (int y = 0; y < H; y++) {
+        const guchar *s = px + (gsize)y * (gsize)rs;
+        guint8 *d = g->data + (gsize)y * (gsize)W;
+        if (mode == GRAY_LUMA) {
+            for (int x = 0; x < W; x++, s += n)
+                d[x] = (guint8)((299 * s[0] + 587 * s[1] + 114 * s[2]) / 1000);
+        } else {
+            for (int x = 0; x < W; x++, s += n)
+                d[x] = (guint8)((s[0] + s[1] + s[2]) / 3);
+        }
+    }
+    return TRUE;
+}
+
+static void ink_table_build(InkTable *t, const GrayImage *g, guint8 thr,
+                            int x0, int y0, int x1, int y1)
+{
+    int w = x1 - x0 + 1, h = y1 - y0 + 1;
+    gsize stride = (gsize)w + 1;
+    gsize size = stride * ((gsize)h + 1);
+    if (size > t->cap) {
+        g_free(t->sum);
+        t->sum = g_malloc(size * sizeof(guint32));
+        t->cap = size;
+    }
+    t->x0 = x0;
+    t->y0 = y0;
+    t->w = w;
+    t->h = h;
+    t->thr = thr;
+
+    memset(t->sum, 0, stride * sizeof(guint32));
+    for (int y = 0; y < h; y++) {
+        const guint8 *row = gray_row(g, y0 + y) + x0;
+        const guint32 *up = t->sum + (gsize)y * stride;
+        guint32 *cur = t->sum + (gsize)(y + 1) * stride;
+        guint32 run = 0;
+        cur[0] = 0;
+        for (int x = 0; x < w; x++) {
+            run += row[x] < thr;
+            cur[x + 1] = up[x + 1] + run;
+        }
+    }
+}
+
+static gboolean ink_table_covers(const InkTable *t, int x0, int y0, int x1, int y1)
+{
+    return x0 >= t->x0 && y0 >= t->y0 && x1 < t->x0 + t->w && y1 < t->y0 + t->h;
+}
+
+const InkTable *gray_ink_table(const GrayImage *g, guint8 thr,
+                               int x0, int y0, int x1, int y1)
+{
+    static const InkTable empty = { .thr = -1 };
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > g->w - 1) x1 = g->w - 1;
+    if (y1 > g->h - 1) y1 = g->h - 1;
+    if (x0 > x1 || y0 > y1) return &empty;
+
+    InkCache *c = g->ink;
+    if (g->binary && thr > 0) thr = 1;
+    for (int i = 0; i < GRAY_INK_TABLES; i++)
+        if (c->t[i].thr == thr && ink_table_covers(&c->t[i], x0, y0, x1, y1))
+            return &c->t[i];
+
+    InkTable *t = NULL;
+    for (int i = 0; i < GRAY_INK_TABLES && !t; i++)
+        if (c->t[i].thr < 0) t = &c->t[i];
+    if (!t) {
+        t = &c->t[c->next];
+        c->next = (c->next + 1) % GRAY_INK_TABLES;
+    }
+    ink_table_build(t, g, thr, x0, y0, x1, y1);
+    return t;
+}
+
+void ink_col_profile(const InkTable *t, int x0, int x1, int y0, int y1, int *out)
+{
+    for (int x = x0; x <= x1; x++)
+        out[x - x0] = ink_count(t, x, y0, x, y1);
+}
+
+void gray_ink_profiles(const GrayImage *g, guint8 thr,
+                       int x0, int x1, int y0, int y1, int *cols, int *rows)
+{
+    if (cols) memset(cols, 0, (gsize)(x1 - x0 + 1) * sizeof(int));
+    if (rows) memset(rows, 0, (gsize)(y1 - y0 + 1) * sizeof(int));
+    int cx0 = x0 < 0 ? 0 : x0;
+    int cy0 = y0 < 0 ? 0 : y0;
+    int cx1 = x1 > g->w - 1 ? g->w - 1 : x1;
+    int cy1 = y1 > g->h - 1 ? g->h - 1 : y1;
+
+    for (int y = cy0; y <= cy1; y++) {
+        const guint8 *row = gray_row(g, y);
+        int n = 0;
+        for (int x = cx0; x <= cx1; x++) {
+            int ink = row[x] < thr;
+            n += ink;
+            if (cols) cols[x - x0] += ink;
+        }
+        if (rows) rows[y - y0] = n;
+    }
+}
+
+void bit_image_init(BitImage *b)
+{
+    memset(b, 0, sizeof(*b));
+}
+
+void bit_image_free(BitImage *b)
+{
+    g_free(b->bits);
+    memset(b, 0, sizeof(*b));
+}
+
+void bit_image_resize(BitImage *b, int w, int h)
+{
+    int words = (w + 63) / 64;
+    gsize size = (gsize)words * (gsize)h;
+    if (size > b->cap) {
+        g_free(b->bits);
+        b->bits = g_malloc(size * sizeof(guint64));
+        b->cap = size;
+    }
+    b->w = w;
+    b->h = h;
+    b->words = words;
+}
+
+void bit_image_from_gray(BitImage *b, const GrayImage *g, guint8 thr)
+{
+    bit_image_resize(b, g->w, g->h);
+    int words = b->words;
+
+    for (int y = 0; y < g->h; y++) {
+        const guint8 *row = gray_row(g, y);
+        guint64 *dst = b->bits + (gsize)y * (gsize)words;
+        for (int w = 0; w < words; w++) {
+            int x0 = w * 64;
+            int n = g->w - x0 < 64 ? g->w - x0 : 64;
+            guint64 m = 0;
+            for (int i = 0; i < n; i++) m |= (guint64)(row[x0 + i] < thr) << i;
+            dst[w] = m;
+        }
+    }
+}
+
+void gray_image_from_bits(GrayImage *g, const BitImage *b)
+{
+    gray_image_resize(g, b->w, b->h);
+    g->binary = TRUE;
+    for (int y = 0; y < b->h; y++) {
+        guint8 *d = g->data + (gsize)y * (gsize)b->w;
+        for (int x = 0; x < b->w; x++) d[x] = bit_at(b, x, y) ? 0 : 255;
+    }
+}
+
+GdkPixbuf *gray_crop_scaled(const GrayImage *g, int x0, int y0, int w, int h,
+                            int out_w, int out_h)
+{
+    if (w <= 0 || h <= 0 || x0 < 0 || y0 < 0 || x0 + w > g->w || y0 + h > g->h)
+        return NULL;
+    GdkPixbuf *pix = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, out_w, out_h);
+    if (!pix) return NULL;
+
+    int rs = gdk_pixbuf_get_rowstride(pix);
+    guchar *px = gdk_pixbuf_get_pixels(pix);
+    for (int y = 0; y < out_h; y++) {
+        const guint8 *src = gray_row(g, y0 + (int)(((gint64)2 * y + 1) * h / (2 * out_h))) + x0;
+        guchar *d = px + (gsize)y * (gsize)rs;
+        for (int x = 0; x < out_w; x++, d += 3)
+            d[0] = d[1] = d[2] = src[((gint64)2 * x + 1) * w / (2 * out_w)];
+    }
+    return pix;
+}
+
+int bit_count_row(const BitImage *b, int y, int x0, int x1)
+{
+    if (y < 0 || y >= b->h) return 0;
+    if (x0 < 0) x0 = 0;
+    if (x1 > b->w - 1) x1 = b->w - 1;
+    if (x0 > x1) return 0;
+
+    const guint64 *row = b->bits + (gsize)y * (gsize)b->words;
+    int w0 = x0 >> 6, w1 = x1 >> 6;
+    guint64 lo = ~(guint64)0 << (x0 & 63);
+    guint64 hi = ~(guint64)0 >> (63 - (x1 & 63));
+    if (w0 == w1) return __builtin_popcountll(row[w0] & lo & hi);
+
+    int cnt = __builtin_popcountll(row[w0] & lo) + __builtin_popcountll(row[w1] & hi);
+    for (int w = w0 + 1; w < w1; w++) cnt += __builtin_popcountll(row[w]);
+    return cnt;
+}
@@ -0,0 +1,125 @@
+#ifndef GRAYIMAGE_H
+#define GRAYIMAGE_H
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+// Summed-area table of the ink mask (gray < thr) over the box whose top-left
+// corner is (x0, y0): sum[y * (w + 1) + x] = ink pixels in
+// [x0, x0 + x) x [y0, y0 + y).
+typedef struct
+{
+    int x0, y0, w, h;
+    int thr;             // -1 while unused
+    guint32 *sum;
+    gsize cap;
+} InkTable;
+
+#define GRAY_INK_TABLES 4
+
+typedef struct
+{
+    InkTable t[GRAY_INK_TABLES];
+    int next;            // slot to recycle when all are taken
+} InkCache;
+
+// Packed 8-bit grayscale copy of a pixbuf, converted once per image so the
+// detectors scan plain arrays instead of going through the pixbuf getters.
+typedef struct
+{
+    int w, h;
+    guint8 *data;        // row-major, stride w
+    gsize cap;
+    InkCache *ink;       // tables per threshold, dropped on reload
+    gboolean binary;     // only 0 (ink) and 255: every threshold gives one mask
+} GrayImage;
+
+// 1-bit ink mask (gray < thr), 64 pixels per word.
+typedef struct
+{
+    int w, h;
+    int words;           // guint64 per row
+    guint64 *bits;
+    gsize cap;
+} BitImage;
+
+typedef enum
+{
+    GRAY_AVG,            // (r + g + b) / 3
+    GRAY_LUMA            // (299 r + 587 g + 114 b) / 1000
+} GrayMode;
+
+void gray_image_init(GrayImage *g);
+void gray_image_free(GrayImage *g);
+// Sets the size of g, reusing its buffer when it is large enough. The pixels
+// are left undefined and the ink tables dropped.
+void gray_image_resize(GrayImage *g, int w, int h);
+// Reuses the buffer of g when it is large enough. Returns FALSE on bad input.
+gboolean gray_image_from_pixbuf(GrayImage *g, const GdkPixbuf *pix, GrayMode mode);
+
+static inline const guint8 *gray_row(const GrayImage *g, int y)
+{
+    return g->data + (gsize)y * (gsize)g->w;
+}
+
+// Coordinates are clamped to the image like the old per-pixel accessors.
+static inline guint8 gray_at(const GrayImage *g, int x, int y)
+{
+    x = x < 0 ? 0 : (x >= g->w ? g->w - 1 : x);
+    y = y < 0 ? 0 : (y >= g->h ? g->h - 1 : y);
+    return g->data[(gsize)y * (gsize)g->w + (gsize)x];
+}
+
+// Integral table of the pixels darker than thr over [x0..x1] x [y0..y1]
+// (clamped to the image). A cached table of the same threshold covering that
+// box is reused; tables are kept until the image is reloaded or
+// gray_image_drop_ink(). Not thread-safe: one GrayImage per thread.
+const InkTable *gray_ink_table(const GrayImage *g, guint8 thr,
+                               int x0, int y0, int x1, int y1);
+
+// Ink pixels in the box [x0..x1] x [y0..y1]; outside the table counts as paper.
+static inline int ink_count(const InkTable *t, int x0, int y0, int x1, int y1)
+{
+    x0 -= t->x0; x1 -= t->x0;
+    y0 -= t->y0; y1 -= t->y0;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > t->w - 1) x1 = t->w - 1;
+    if (y1 > t->h - 1) y1 = t->h - 1;
+    if (x0 > x1 || y0 > y1) return 0;
+    gsize s = (gsize)t->w + 1;
+    const guint32 *a = t->sum + (gsize)y0 * s;
+    const guint32 *b = t->sum + (gsize)(y1 + 1) * s;
+    return (int)(b[x1 + 1] - b[x0] - a[x1 + 1] + a[x0]);
+}
+
+// out[x - x0] = ink pixels of column x in [y0..y1].
+void ink_col_profile(const InkTable *t, int x0, int x1, int y0, int y1, int *out);
+
+// Ink projections of the box [x0..x1] x [y0..y1] in one pass, without a
+// table: cols[x - x0] = ink pixels of column x, rows[y - y0] = ink pixels
+// of row y. Either output may be NULL; outside the image counts as paper.
+void gray_ink_profiles(const GrayImage *g, guint8 thr,
+                       int x0, int x1, int y0, int y1, int *cols, int *rows);
+
+void bit_image_init(BitImage *b);
+void bit_image_free(BitImage *b);
+void bit_image_resize(BitImage *b, int w, int h);
+void bit_image_from_gray(BitImage *b, const GrayImage *g, guint8 thr);
+// Ink as 0, paper as 255, and g marked binary.
+void gray_image_from_bits(GrayImage *g, const BitImage *b);
+
+// RGB out_w x out_h copy of the box (x0, y0, w, h) of g, nearest neighbour so
+// a binary g gives a tile that is still only 0 and 255.
+GdkPixbuf *gray_crop_scaled(const GrayImage *g, int x0, int y0, int w, int h,
+                            int out_w, int out_h);
+
+static inline gboolean bit_at(const BitImage *b, int x, int y)
+{
+    return (b->bits[(gsize)y * (gsize)b->words + (x >> 6)] >> (x & 63)) & 1;
+}
+
+// Ink pixels in [x0..x1] of row y, by popcount.
+int bit_count_row(const BitImage *b, int y, int x0, int x1);
+
+#endif
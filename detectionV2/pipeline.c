@@ -0,0 +1,162 @@
+#include <glib.h>
+#include "pipeline.h"
+
+typedef struct
+{
+    void *job;
+    int item;
+} PipeSlot;
+
+// FIFO of slots. Never more than n_jobs slots exist, so a ring of that size
+// cannot overflow and put never waits.
+typedef struct
+{
+    PipeSlot *ring;
+    int cap, head, len;
+    int producers;       // threads that may still put; 0 = closed
+    GMutex lock;
+    GCond ready;
+} PipeQueue;
+
+typedef struct
+{
+    const PipeStage *stage;
+    PipeQueue *in, *out;
+    void *ctx;
+} StageRun;
+
+typedef struct
+{
+    PipeQueue *free_jobs, *first;
+    int n_items;
+} Feeder;
+
+static void queue_init(PipeQueue *q, int cap, int producers)
+{
+    q->ring = g_malloc(sizeof(PipeSlot) * cap);
+    q->cap = cap;
+    q->head = q->len = 0;
+    q->producers = producers;
+    g_mutex_init(&q->lock);
+    g_cond_init(&q->ready);
+}
+
+static void queue_clear(PipeQueue *q)
+{
+    g_free(q->ring);
+    g_mutex_clear(&q->lock);
+    g_cond_clear(&q->ready);
+}
+
+static void queue_put(PipeQueue *q, PipeSlot s)
+{
+    g_mutex_lock(&q->lock);
+    q->ring[(q->head + q->len) % q->cap] = s;
+    q->len++;
+    g_cond_signal(&q->ready);
+    g_mutex_unlock(&q->lock);
+}
+
+// FALSE once every producer is done and the queue is empty.
+static gboolean queue_get(PipeQueue *q, PipeSlot *s)
+{
+    g_mutex_lock(&q->lock);
+    while (q->len == 0 && q->producers > 0) g_cond_wait(&q->ready, &q->lock);
+    gboolean ok = q->len > 0;
+    if (ok) {
+        *s = q->ring[q->head];
+        q->head = (q->head + 1) % q->cap;
+        q->len--;
+    }
+    g_mutex_unlock(&q->lock);
+    return ok;
+}
+
+static void queue_producer_done(PipeQueue *q)
+{
+    g_mutex_lock(&q->lock);
+    if (--q->producers == 0) g_cond_broadcast(&q->ready);
+    g_mutex_unlock(&q->lock);
+}
+
+static gpointer stage_main(gpointer data)
+{
+    StageRun *run = data;
+    PipeSlot s;
+    while (queue_get(run->in, &s)) {
+        run->stage->fn(s.job, s.item, run->ctx);
+        queue_put(run->out, s);
+    }
+    queue_producer_done(run->out);
+    return NULL;
+}
+
+// Hands out the items in order, each in the next free job.
+static gpointer feeder_main(gpointer data)
+{
+    Feeder *f = data;
+    PipeSlot s;
+    for (int i = 0; i < f->n_items && queue_get(f->free_jobs, &s); i++) {
+        s.item = i;
+        queue_put(f->first, s);
+    }
+    queue_producer_done(f->first);
+    return NULL;
+}
+
+void pipeline_run(void **jobs, int n_jobs, int n_items,
+                  const PipeStage *stages, int n_stages,
+                  PipeStageFn sink, void *ctx)
+{
+    if (n_items <= 0 || n_jobs <= 0) return;
+
+    // queues[0] feeds stage 0, queues[n_stages] the sink
+    PipeQueue *queues = g_malloc(sizeof(PipeQueue) * (n_stages + 1));
+    queue_init(&queues[0], n_jobs, 1);
+    for (int s = 0; s < n_stages; s++)
+        queue_init(&queues[s + 1], n_jobs, MAX(stages[s].threads, 1));
+    PipeQueue free_jobs;
+    queue_init(&free_jobs, n_jobs, 1);
+    for (int j = 0; j < n_jobs; j++) queue_put(&free_jobs, (PipeSlot){ jobs[j], -1 });
+
+    int n_threads = 1;
+    for (int s = 0; s < n_stages; s++) n_threads += MAX(stages[s].threads, 1);
+    GThread **threads = g_malloc(sizeof(GThread *) * n_threads);
+    StageRun *runs = g_malloc(sizeof(StageRun) * (n_stages > 0 ? n_stages : 1));
+    Feeder feeder = { &free_jobs, &queues[0], n_items };
+
+    int t = 0;
+    threads[t++] = g_thread_new("pipe-feed", feeder_main, &feeder);
+    for (int s = 0; s < n_stages; s++) {
+        runs[s] = (StageRun){ &stages[s], &queues[s], &queues[s + 1], ctx };
+        for (int k = 0; k < MAX(stages[s].threads, 1); k++)
+            threads[t++] = g_thread_new("pipe-stage", stage_main, &runs[s]);
+    }
+
+    // Stages with several threads may finish items out of order: the sink
+    // keeps early ones until their turn. At most n_jobs are in flight, so
+    // item % n_jobs never collides.
+    PipeSlot *pending = g_malloc(sizeof(PipeSlot) * n_jobs);
+    for (int j = 0; j < n_jobs; j++) pending[j].item = -1;
+    int next = 0;
+    PipeSlot s;
+    while (next < n_items && queue_get(&queues[n_stages], &s)) {
+        pending[s.item % n_jobs] = s;
+        while (next < n_items && pending[next % n_jobs].item == next) {
+            PipeSlot done = pending[next % n_jobs];
+            pending[next % n_jobs].item = -1;
+            sink(done.job, done.item, ctx);
+            queue_put(&free_jobs, done);
+            next++;
+        }
+    }
+    queue_producer_done(&free_jobs);
+
+    for (int i = 0; i < t; i++) g_thread_join(threads[i]);
+    g_free(pending);
+    g_free(runs);
+    g_free(threads);
+    for (int q = 0; q <= n_stages; q++) queue_clear(&queues[q]);
+    queue_clear(&free_jobs);
+    g_free(queues);
+}
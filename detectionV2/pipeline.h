@@ -0,0 +1,22 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+// Streaming pipeline: items go through every stage in turn, each stage with
+// its own threads, so the stages of consecutive items overlap.
+typedef void (*PipeStageFn)(void *job, int item, void *ctx);
+
+typedef struct
+{
+    PipeStageFn fn;
+    int threads;
+} PipeStage;
+
+// Runs items 0..n_items-1 through stages[0..n_stages-1]. jobs are n_jobs
+// work areas reused from item to item: they bound the items in flight and
+// so every queue between stages. sink(job, item, ctx) runs on the calling
+// thread in item order, after which the job is reused.
+void pipeline_run(void **jobs, int n_jobs, int n_items,
+                  const PipeStage *stages, int n_stages,
+                  PipeStageFn sink, void *ctx);
+
+#endif
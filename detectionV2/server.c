@@ -0,0 +1,661 @@
+#define _POSIX_C_SOURCE 200809L
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "detection.h"
+#include "model.h"
+#include "workers.h"
+#include "trace.h"
+
+// ./ocr_project serve: the model is loaded once, then the main thread polls
+// the UNIX socket and the idle connections, and queues every connection that
+// has a request to read. A worker thread answers that one request and hands
+// the connection back, so a client that keeps its connection open only holds
+// a worker while one of its requests runs.
+// Line protocol, any number of requests per connection, one JSON line back
+// for each:
+//   IMAGE <path>\n          image file readable by the server
+//   DATA <bytes>\n<raw>     encoded image (PNG, JPEG...) sent inline
+//   STATS\n                 counters and latency histograms
+
+#define DEFAULT_SOCKET "ocr_project.sock"
+#define MAX_LINE 4096
+#define MAX_DATA_BYTES (64 << 20)
+#define REQUEST_TIMEOUT_S 30   // to receive a whole request, from when it is queued
+#define HIST_BUCKETS 32   // bucket b: durations of b significant bits, in us
+
+typedef struct
+{
+    guint64 count, sum_us, max_us;
+    guint64 buckets[HIST_BUCKETS];
+} Histogram;
+
+enum { HIST_REQUEST, HIST_QUEUE_WAIT, HIST_STAGE0, HIST_COUNT = HIST_STAGE0 + DETECT_STAGE_COUNT };
+
+// Buffered reader on a connection; DATA payloads follow their line directly.
+// Owned by the main thread while idle, by one worker while queued or running;
+// only the main thread closes fd.
+typedef struct
+{
+    int fd;
+    char buf[MAX_LINE];
+    int start, end;
+    gboolean open;       // cleared by the worker on end of stream, error or timeout
+    gint64 queued_at;
+    gint64 deadline;     // the request must be read by then
+    int state;           // CONN_*, main thread only
+} Conn;
+
+enum { CONN_IDLE, CONN_READY, CONN_BUSY };   // READY: a request already buffered
+
+typedef struct
+{
+    DetectionOptions opt;
+
+    // connections with a request to read, oldest first, at most cap of them
+    GMutex lock;
+    GCond not_empty;
+    GQueue ready;
+    int cap;
+    gboolean closing;
+    int wake[2];         // workers write back the Conn * they are done with
+
+    GMutex stats_lock;
+    Histogram hist[HIST_COUNT];
+    guint64 accepted, rejected, jobs, failed;
+    int nb_workers;
+    gint64 started;
+} Server;
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void on_stop_signal(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+// Queue
+
+// Only the main thread pushes, after checking queue_length() against cap.
+static void queue_push(Server *s, Conn *c)
+{
+    c->queued_at = g_get_monotonic_time();
+    c->deadline = c->queued_at + (gint64)REQUEST_TIMEOUT_S * G_USEC_PER_SEC;
+    g_mutex_lock(&s->lock);
+    g_queue_push_tail(&s->ready, c);
+    g_cond_signal(&s->not_empty);
+    g_mutex_unlock(&s->lock);
+}
+
+static int queue_length(Server *s)
+{
+    g_mutex_lock(&s->lock);
+    int n = (int)s->ready.length;
+    g_mutex_unlock(&s->lock);
+    return n;
+}
+
+// Blocks until a connection is queued. NULL once the queue is closed and empty.
+static Conn *queue_pop(Server *s)
+{
+    g_mutex_lock(&s->lock);
+    while (s->ready.length == 0 && !s->closing) g_cond_wait(&s->not_empty, &s->lock);
+    Conn *c = g_queue_pop_head(&s->ready);
+    g_mutex_unlock(&s->lock);
+    return c;
+}
+
+static void queue_close(Server *s)
+{
+    g_mutex_lock(&s->lock);
+    s->closing = TRUE;
+    g_cond_broadcast(&s->not_empty);
+    g_mutex_unlock(&s->lock);
+}
+
+// Stats
+
+static void hist_add(Histogram *h, gint64 us)
+{
+    guint64 v = us > 0 ? (guint64)us : 0;
+    int b = 0;
+    while (b < HIST_BUCKETS - 1 && (v >> b) != 0) b++;
+    h->count++;
+    h->sum_us += v;
+    if (v > h->max_us) h->max_us = v;
+    h->buckets[b]++;
+}
+
+// Upper bound of the bucket holding the q-quantile, capped by the maximum.
+static guint64 hist_quantile(const Histogram *h, double q)
+{
+    if (h->count == 0) return 0;
+    guint64 rank = (guint64)(q * (double)h->count + 0.5);
+    if (rank < 1) rank = 1;
+    guint64 seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen >= rank) {
+            guint64 upper = b == 0 ? 0 : ((guint64)1 << b) - 1;
+            return MIN(upper, h->max_us);
+        }
+    }
+    return h->max_us;
+}
+
+static void hist_append_json(GString *out, const char *name, const Histogram *h)
+{
+    g_string_append_printf(out, "\"%s\":{\"count\":%llu,\"mean\":%.1f,\"max\":%llu,"
+                           "\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"buckets\":[",
+                           name, (unsigned long long)h->count,
+                           h->count ? (double)h->sum_us / (double)h->count : 0.0,
+                           (unsigned long long)h->max_us,
+                           (unsigned long long)hist_quantile(h, 0.50),
+                           (unsigned long long)hist_quantile(h, 0.90),
+                           (unsigned long long)hist_quantile(h, 0.99));
+    int last = HIST_BUCKETS - 1;
+    while (last > 0 && h->buckets[last] == 0) last--;
+    for (int b = 0; b <= last; b++)
+        g_string_append_printf(out, b ? ",%llu" : "%llu", (unsigned long long)h->buckets[b]);
+    g_string_append(out, "]}");
+}
+
+static char *stats_json(Server *s)
+{
+    int queued = queue_length(s);
+
+    GString *out = g_string_new("");
+    g_mutex_lock(&s->stats_lock);
+    g_string_append_printf(out, "{\"ok\":true,\"uptime_s\":%.1f,\"workers\":%d,"
+                           "\"queue\":{\"length\":%d,\"capacity\":%d},"
+                           "\"connections\":{\"accepted\":%llu,\"rejected\":%llu},"
+                           "\"jobs\":{\"done\":%llu,\"failed\":%llu},\"latency_us\":{",
+                           (g_get_monotonic_time() - s->started) / 1e6, s->nb_workers,
+                           queued, s->cap,
+                           (unsigned long long)s->accepted, (unsigned long long)s->rejected,
+                           (unsigned long long)s->jobs, (unsigned long long)s->failed);
+    hist_append_json(out, "request", &s->hist[HIST_REQUEST]);
+    g_string_append_c(out, ',');
+    hist_append_json(out, "queue_wait", &s->hist[HIST_QUEUE_WAIT]);
+    for (int st = 0; st < DETECT_STAGE_COUNT; st++) {
+        g_string_append_c(out, ',');
+        hist_append_json(out, detection_stage_name(st), &s->hist[HIST_STAGE0 + st]);
+    }
+    g_string_append(out, "}}");
+    g_mutex_unlock(&s->stats_lock);
+    return g_string_free(out, FALSE);
+}
+
+// Connection I/O
+
+static gboolean send_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return FALSE;
+        data += n;
+        len -= (size_t)n;
+    }
+    return TRUE;
+}
+
+static gboolean send_reply(int fd, const char *json)
+{
+    return send_all(fd, json, strlen(json)) && send_all(fd, "\n", 1);
+}
+
+static gboolean conn_has_line(const Conn *c)
+{
+    return memchr(c->buf + c->start, '\n', (size_t)(c->end - c->start)) != NULL;
+}
+
+// Waits for data until the request deadline. Data already there is read
+// even past it, so only a client that stalls is dropped.
+static gboolean conn_wait(const Conn *c)
+{
+    struct pollfd p = { c->fd, POLLIN, 0 };
+    for (;;) {
+        gint64 left = c->deadline - g_get_monotonic_time();
+        int r = poll(&p, 1, left > 0 ? (int)((left + 999) / 1000) : 0);
+        if (r >= 0 || errno != EINTR) return r > 0;
+    }
+}
+
+static gboolean conn_fill(Conn *c)
+{
+    if (c->start > 0) {
+        memmove(c->buf, c->buf + c->start, (size_t)(c->end - c->start));
+        c->end -= c->start;
+        c->start = 0;
+    }
+    if (c->end == MAX_LINE || !conn_wait(c)) return FALSE;
+    ssize_t n;
+    do n = recv(c->fd, c->buf + c->end, (size_t)(MAX_LINE - c->end), 0);
+    while (n < 0 && errno == EINTR);
+    if (n <= 0) return FALSE;
+    c->end += (int)n;
+    return TRUE;
+}
+
+// Next line without its "\n" (and "\r"), NUL-terminated in line.
+// FALSE on end of stream, timeout or a line longer than MAX_LINE.
+static gboolean conn_read_line(Conn *c, char line[MAX_LINE])
+{
+    for (;;) {
+        char *nl = memchr(c->buf + c->start, '\n', (size_t)(c->end - c->start));
+        if (nl) {
+            int len = (int)(nl - (c->buf + c->start));
+            memcpy(line, c->buf + c->start, (size_t)len);
+            if (len > 0 && line[len - 1] == '\r') len--;
+            line[len] = '\0';
+            c->start += (int)(nl - (c->buf + c->start)) + 1;
+            return TRUE;
+        }
+        if (!conn_fill(c)) return FALSE;
+    }
+}
+
+static gboolean conn_read_exact(Conn *c, guchar *dst, size_t len)
+{
+    size_t buffered = MIN(len, (size_t)(c->end - c->start));
+    memcpy(dst, c->buf + c->start, buffered);
+    c->start += (int)buffered;
+    for (size_t got = buffered; got < len;) {
+        if (!conn_wait(c)) return FALSE;
+        ssize_t n = recv(c->fd, dst + got, len - got, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return FALSE;
+        got += (size_t)n;
+    }
+    return TRUE;
+}
+
+static char *error_json(const char *what, const char *detail)
+{
+    GString *out = g_string_new("{\"ok\":false,\"error\":\"");
+    g_string_append(out, what);
+    if (detail) {
+        g_string_append(out, ": ");
+        for (const char *p = detail; *p; p++)
+            if ((unsigned char)*p >= 0x20 && *p != '"' && *p != '\\') g_string_append_c(out, *p);
+    }
+    g_string_append(out, "\"}");
+    return g_string_free(out, FALSE);
+}
+
+static GdkPixbuf *decode_bytes(const guchar *data, size_t len, GError **err)
+{
+    TRACE_SCOPE("decode");
+    GdkPixbufLoader *loader = gdk_pixbuf_loader_new();
+    GdkPixbuf *img = NULL;
+    gboolean ok = gdk_pixbuf_loader_write(loader, data, len, err);
+    ok = gdk_pixbuf_loader_close(loader, ok ? err : NULL) && ok;
+    if (ok) {
+        img = gdk_pixbuf_loader_get_pixbuf(loader);
+        if (img) g_object_ref(img);
+    }
+    g_object_unref(loader);
+    return img;
+}
+
+// Runs one IMAGE or DATA request. *keep is cleared when the connection can
+// no longer be read (truncated payload).
+static char *solve_request(Server *s, DetectionWorker *w, Conn *c, const char *line,
+                           gboolean *keep)
+{
+    gint64 stage_us[DETECT_STAGE_COUNT] = {0};
+    gint64 t = g_get_monotonic_time();
+    GError *err = NULL;
+    GdkPixbuf *img = NULL;
+
+    if (strncmp(line, "IMAGE ", 6) == 0) {
+        TraceScope decode = trace_begin("decode");
+        img = gdk_pixbuf_new_from_file(line + 6, &err);
+        trace_end(&decode);
+    } else {
+        char *end = NULL;
+        unsigned long long n = strtoull(line + 5, &end, 10);
+        if (end == line + 5 || *end != '\0' || n == 0 || n > MAX_DATA_BYTES) {
+            *keep = FALSE;
+            return error_json("bad DATA size", NULL);
+        }
+        guchar *data = g_malloc((gsize)n);
+        if (!conn_read_exact(c, data, (size_t)n)) {
+            g_free(data);
+            *keep = FALSE;
+            return error_json("truncated DATA", NULL);
+        }
+        img = decode_bytes(data, (size_t)n, &err);
+        g_free(data);
+    }
+
+    char *reply;
+    if (!img) {
+        reply = error_json("cannot decode image", err ? err->message : NULL);
+        g_clear_error(&err);
+    } else {
+        stage_us[DETECT_STAGE_DECODE] = g_get_monotonic_time() - t;
+        reply = detection_worker_solve_json(w, img, stage_us);
+        g_object_unref(img);
+    }
+    gboolean ok = strncmp(reply, "{\"ok\":true", 10) == 0;
+
+    g_mutex_lock(&s->stats_lock);
+    if (ok) s->jobs++;
+    else s->failed++;
+    hist_add(&s->hist[HIST_REQUEST], g_get_monotonic_time() - t);
+    for (int st = 0; st < DETECT_STAGE_COUNT; st++)
+        if (stage_us[st] > 0) hist_add(&s->hist[HIST_STAGE0 + st], stage_us[st]);
+    g_mutex_unlock(&s->stats_lock);
+    return reply;
+}
+
+// Reads and answers one request of c. Blank lines already buffered are
+// skipped; c->open is cleared when the connection is done.
+static void serve_request(Server *s, DetectionWorker *w, Conn *c)
+{
+    char line[MAX_LINE];
+    do {
+        if (!conn_read_line(c, line)) {
+            c->open = FALSE;
+            return;
+        }
+    } while (line[0] == '\0' && conn_has_line(c));
+    if (line[0] == '\0') return;
+
+    char *reply;
+    gboolean keep = TRUE;
+    if (strcmp(line, "STATS") == 0)
+        reply = stats_json(s);
+    else if (strncmp(line, "IMAGE ", 6) == 0 || strncmp(line, "DATA ", 5) == 0)
+        reply = solve_request(s, w, c, line, &keep);
+    else
+        reply = error_json("unknown request", NULL);
+    if (!send_reply(c->fd, reply) || !keep) c->open = FALSE;
+    g_free(reply);
+}
+
+static gpointer worker_main(gpointer data)
+{
+    Server *s = data;
+    // one request per core already: classification stays on this thread
+    workers_set_serial(TRUE);
+    DetectionWorker *w = detection_worker_new(&s->opt);
+
+    Conn *c;
+    while ((c = queue_pop(s)) != NULL) {
+        gint64 wait = g_get_monotonic_time() - c->queued_at;
+        g_mutex_lock(&s->stats_lock);
+        hist_add(&s->hist[HIST_QUEUE_WAIT], wait);
+        g_mutex_unlock(&s->stats_lock);
+
+        serve_request(s, w, c);
+        // Stopping: the main thread shut the reading side, so the requests
+        // already sent are answered and the loop ends on end of stream.
+        while (g_stop && c->open) serve_request(s, w, c);
+        ssize_t n;
+        do n = write(s->wake[1], &c, sizeof(c));
+        while (n < 0 && errno == EINTR);
+    }
+    detection_worker_free(w);
+    return NULL;
+}
+
+// Socket
+
+static int open_listener(const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        g_printerr("[Error] socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    // A socket file nobody answers on is left over from a killed server.
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe >= 0 && connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        close(probe);
+        g_printerr("[Error] a server is already running on %s\n", path);
+        return -1;
+    }
+    if (probe >= 0) close(probe);
+    unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        g_printerr("[Error] cannot listen on %s: %s\n", path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static Conn *conn_new(int fd)
+{
+    Conn *c = g_malloc(sizeof(Conn));
+    c->fd = fd;
+    c->start = c->end = 0;
+    c->open = TRUE;
+    c->queued_at = 0;
+    c->deadline = 0;
+    c->state = CONN_IDLE;
+    return c;
+}
+
+static void conn_close(Conn *c)
+{
+    close(c->fd);
+    g_free(c);
+}
+
+static void reject(Server *s, int fd)
+{
+    send_reply(fd, "{\"ok\":false,\"error\":\"queue full\"}");
+    close(fd);
+    g_mutex_lock(&s->stats_lock);
+    s->rejected++;
+    g_mutex_unlock(&s->stats_lock);
+}
+
+int detection_run_server(int argc, char **argv)
+{
+    const char *path = DEFAULT_SOCKET;
+    int nb_threads = (int)g_get_num_processors();
+    int queue_cap = 0;
+
+    Server s;
+    memset(&s, 0, sizeof(s));
+    detection_options_init(&s.opt);
+    int first = 1;
+    while (first < argc) {
+        int next = detection_parse_options(argc, argv, first, &s.opt);
+        if (next < 0) break;
+        if (next > first) {
+            first = next;
+            continue;
+        }
+        if (first + 1 >= argc) break;
+        if (strcmp(argv[first], "--socket") == 0) path = argv[first + 1];
+        else if (strcmp(argv[first], "--threads") == 0) nb_threads = atoi(argv[first + 1]);
+        else if (strcmp(argv[first], "--queue") == 0) queue_cap = atoi(argv[first + 1]);
+        else break;
+        first += 2;
+    }
+    if (first < argc || nb_threads < 1 || queue_cap < 0) {
+        printf("Usage: ./ocr_project serve [--socket PATH] [--threads N] [--queue N] [--deskew hough|profile] [--binarize otsu|sauvola]\n");
+        return 1;
+    }
+    if (queue_cap == 0) queue_cap = 2 * nb_threads;
+    s.opt.dump_glyphs = FALSE;
+
+    int lfd = open_listener(path);
+    if (lfd < 0) return 1;
+    // loaded before the first client, not by it
+    model_get();
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+    sa.sa_handler = on_stop_signal;   // no SA_RESTART: poll() returns at once
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (pipe(s.wake) != 0) {
+        g_printerr("[Error] pipe: %s\n", strerror(errno));
+        close(lfd);
+        unlink(path);
+        return 1;
+    }
+    fcntl(s.wake[0], F_SETFL, O_NONBLOCK);
+    g_mutex_init(&s.lock);
+    g_cond_init(&s.not_empty);
+    g_mutex_init(&s.stats_lock);
+    g_queue_init(&s.ready);
+    s.cap = queue_cap;
+    s.nb_workers = nb_threads;
+    s.started = g_get_monotonic_time();
+
+    // Workers inherit a mask without the stop signals, so they land on the
+    // main thread and interrupt its poll() right away.
+    sigset_t stop_set, old_set;
+    sigemptyset(&stop_set);
+    sigaddset(&stop_set, SIGINT);
+    sigaddset(&stop_set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_set, &old_set);
+    GThread **threads = g_malloc(sizeof(GThread *) * nb_threads);
+    for (int i = 0; i < nb_threads; i++)
+        threads[i] = g_thread_new("ocr-serve", worker_main, &s);
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+    g_print("[Serve] listening on %s (%d workers, queue %d)\n", path, nb_threads, queue_cap);
+
+    // Open connections; idle ones wait in the poll set for their next request.
+    GPtrArray *conns = g_ptr_array_new();
+    GArray *pfds = g_array_new(FALSE, FALSE, sizeof(struct pollfd));
+    GPtrArray *polled = g_ptr_array_new();   // Conn of pfds[2], pfds[3]...
+
+    while (!g_stop) {
+        // Connections handed back with a request already buffered go first.
+        int room = s.cap - queue_length(&s);
+        for (guint i = 0; i < conns->len && room > 0; i++) {
+            Conn *c = g_ptr_array_index(conns, i);
+            if (c->state != CONN_READY) continue;
+            c->state = CONN_BUSY;
+            queue_push(&s, c);
+            room--;
+        }
+
+        // While the queue is full, requests stay in the socket buffers.
+        g_array_set_size(pfds, 0);
+        struct pollfd p = { lfd, POLLIN, 0 };
+        g_array_append_val(pfds, p);
+        p.fd = s.wake[0];
+        g_array_append_val(pfds, p);
+        g_ptr_array_set_size(polled, 0);
+        for (guint i = 0; i < conns->len && room > 0; i++) {
+            Conn *c = g_ptr_array_index(conns, i);
+            if (c->state != CONN_IDLE) continue;
+            p.fd = c->fd;
+            g_array_append_val(pfds, p);
+            g_ptr_array_add(polled, c);
+        }
+        if (poll((struct pollfd *)pfds->data, pfds->len, 500) <= 0) continue;
+        struct pollfd *pf = (struct pollfd *)pfds->data;
+
+        for (guint k = 0; k < polled->len; k++) {
+            if (!pf[2 + k].revents) continue;
+            Conn *c = g_ptr_array_index(polled, k);
+            // A client that hung up is closed here rather than taking a
+            // queue slot and a worker to find out.
+            char b;
+            ssize_t n = recv(c->fd, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                g_ptr_array_remove_fast(conns, c);
+                conn_close(c);
+                continue;
+            }
+            c->state = CONN_BUSY;
+            queue_push(&s, c);
+        }
+
+        if (pf[1].revents) {
+            Conn *back[64];
+            ssize_t n;
+            while ((n = read(s.wake[0], back, sizeof(back))) > 0) {
+                for (int j = 0; j < (int)(n / (ssize_t)sizeof(Conn *)); j++) {
+                    Conn *c = back[j];
+                    if (!c->open) {
+                        g_ptr_array_remove_fast(conns, c);
+                        conn_close(c);
+                    } else {
+                        c->state = conn_has_line(c) ? CONN_READY : CONN_IDLE;
+                    }
+                }
+            }
+        }
+
+        if (pf[0].revents) {
+            int fd = accept(lfd, NULL, NULL);
+            if (fd < 0) continue;
+            if (queue_length(&s) >= s.cap) {
+                reject(&s, fd);
+                continue;
+            }
+            g_ptr_array_add(conns, conn_new(fd));
+            g_mutex_lock(&s.stats_lock);
+            s.accepted++;
+            g_mutex_unlock(&s.stats_lock);
+        }
+    }
+
+    g_print("[Serve] stopping\n");
+    close(lfd);
+    unlink(path);
+    // Requests already sent are answered: idle connections with data are
+    // queued, the others closed, and the reading side of every connection
+    // left is shut so no worker waits in recv() for more.
+    for (guint i = 0; i < conns->len;) {
+        Conn *c = g_ptr_array_index(conns, i);
+        if (c->state == CONN_IDLE) {
+            struct pollfd q = { c->fd, POLLIN, 0 };
+            if (poll(&q, 1, 0) <= 0 || !(q.revents & POLLIN)) {
+                g_ptr_array_remove_index_fast(conns, i);
+                conn_close(c);
+                continue;
+            }
+        }
+        shutdown(c->fd, SHUT_RD);
+        if (c->state != CONN_BUSY) queue_push(&s, c);
+        i++;
+    }
+    queue_close(&s);
+    for (int i = 0; i < nb_threads; i++) g_thread_join(threads[i]);
+    g_free(threads);
+    for (guint i = 0; i < conns->len; i++) conn_close(g_ptr_array_index(conns, i));
+    g_ptr_array_free(conns, TRUE);
+    g_ptr_array_free(polled, TRUE);
+    g_array_free(pfds, TRUE);
+    close(s.wake[0]);
+    close(s.wake[1]);
+
+    g_print("[Serve] %llu images solved, %llu failed, %llu connections rejected\n",
+            (unsigned long long)s.jobs, (unsigned long long)s.failed,
+            (unsigned long long)s.rejected);
+    g_mutex_clear(&s.lock);
+    g_cond_clear(&s.not_empty);
+    g_mutex_clear(&s.stats_lock);
+    return 0;
+}
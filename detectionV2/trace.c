@@ -0,0 +1,192 @@
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+#define TRACE_MAX_NAMES 64
+#define TRACE_CHUNK 1024          // JSON events buffered before they are written
+#define TRACE_FLUSH_US 1000000    // and written at least once a second
+
+typedef enum { TRACE_OFF, TRACE_SUMMARY, TRACE_JSON } TraceMode;
+
+typedef struct
+{
+    const char *name;
+    guint64 calls;
+    gint64 total_us, max_us;
+} TraceStat;
+
+// JSON mode: a timed scope ("X" event) or a counter increment ("C" event).
+typedef struct
+{
+    const char *name;
+    gint64 ts;
+    gint64 value;       // scope duration, or counter running total
+    int tid;
+    int counter;        // -1 for a scope
+} TraceEvent;
+
+static const char *COUNTER_NAMES[TRACE_COUNTER_COUNT] = {
+    "pixels", "components", "glyphs", "files"
+};
+
+static TraceMode g_mode = TRACE_OFF;
+static char *g_json_path = NULL;
+static gint64 g_origin = 0;
+static GMutex g_lock;
+static TraceStat g_stats[TRACE_MAX_NAMES];
+static int g_nstats = 0;
+static gint64 g_counters[TRACE_COUNTER_COUNT];
+static FILE *g_json = NULL;
+static TraceEvent g_events[TRACE_CHUNK];
+static int g_nevents = 0;
+static guint64 g_written = 0;
+static gint64 g_last_write = 0;
+static volatile gint g_next_tid = 0;
+static GPrivate g_tid = G_PRIVATE_INIT(NULL);
+
+static void trace_flush(void);
+
+static void trace_init(void)
+{
+    static gsize once = 0;
+    if (!g_once_init_enter(&once)) return;
+
+    const char *env = g_getenv("OCR_TRACE");
+    if (env && strcmp(env, "summary") == 0) {
+        g_mode = TRACE_SUMMARY;
+    } else if (env && strncmp(env, "json", 4) == 0) {
+        // Array form of the trace format: the closing bracket is optional,
+        // so the file stays loadable while a server is still running.
+        g_json_path = g_strdup(env[4] == ':' && env[5] ? env + 5 : "ocr_trace.json");
+        g_json = fopen(g_json_path, "w");
+        if (g_json) {
+            g_mode = TRACE_JSON;
+            fprintf(g_json, "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+                    "\"args\":{\"name\":\"ocr_project\"}}");
+        } else {
+            fprintf(stderr, "[Trace] cannot write %s, printing a summary instead\n", g_json_path);
+            g_mode = TRACE_SUMMARY;
+        }
+    }
+    if (g_mode != TRACE_OFF) {
+        g_origin = g_get_monotonic_time();
+        atexit(trace_flush);
+    }
+    g_once_init_leave(&once, 1);
+}
+
+gboolean trace_enabled(void)
+{
+    trace_init();
+    return g_mode != TRACE_OFF;
+}
+
+// Small per-thread id for the trace viewer, 1 for the first traced thread.
+static int thread_id(void)
+{
+    int id = GPOINTER_TO_INT(g_private_get(&g_tid));
+    if (id == 0) {
+        id = g_atomic_int_add(&g_next_tid, 1) + 1;
+        g_private_set(&g_tid, GINT_TO_POINTER(id));
+    }
+    return id;
+}
+
+// Appends the buffered events to the file. Called with g_lock held.
+static void write_events(void)
+{
+    for (int i = 0; i < g_nevents; i++) {
+        const TraceEvent *e = &g_events[i];
+        if (e->counter < 0)
+            fprintf(g_json, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld}",
+                    e->name, e->tid, (long long)e->ts, (long long)e->value);
+        else
+            fprintf(g_json, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%lld,\"args\":{\"%s\":%lld}}",
+                    e->name, (long long)e->ts, e->name, (long long)e->value);
+    }
+    fflush(g_json);
+    g_written += (guint64)g_nevents;
+    g_nevents = 0;
+}
+
+// Called with g_lock held.
+static void push_event(TraceEvent ev)
+{
+    if (!g_json) return;   // a thread still running after the exit flush
+    g_events[g_nevents++] = ev;
+    if (g_nevents == TRACE_CHUNK || ev.ts - g_last_write >= TRACE_FLUSH_US) {
+        write_events();
+        g_last_write = ev.ts;
+    }
+}
+
+TraceScope trace_begin(const char *name)
+{
+    TraceScope s = { name, 0 };
+    if (trace_enabled()) s.start = g_get_monotonic_time();
+    return s;
+}
+
+void trace_end(TraceScope *scope)
+{
+    if (scope->start == 0) return;
+    gint64 dur = g_get_monotonic_time() - scope->start;
+    int tid = g_mode == TRACE_JSON ? thread_id() : 0;
+
+    g_mutex_lock(&g_lock);
+    int i = 0;
+    while (i < g_nstats && strcmp(g_stats[i].name, scope->name) != 0) i++;
+    if (i == g_nstats && g_nstats < TRACE_MAX_NAMES) g_stats[g_nstats++].name = scope->name;
+    if (i < g_nstats) {
+        g_stats[i].calls++;
+        g_stats[i].total_us += dur;
+        if (dur > g_stats[i].max_us) g_stats[i].max_us = dur;
+    }
+    if (g_mode == TRACE_JSON)
+        push_event((TraceEvent){ scope->name, scope->start - g_origin, dur, tid, -1 });
+    g_mutex_unlock(&g_lock);
+}
+
+void trace_count(TraceCounter counter, gint64 n)
+{
+    if (!trace_enabled() || n == 0) return;
+    g_mutex_lock(&g_lock);
+    gint64 ts = g_get_monotonic_time() - g_origin;
+    g_counters[counter] += n;
+    // counters are drawn as tracks of their running total
+    if (g_mode == TRACE_JSON)
+        push_event((TraceEvent){ COUNTER_NAMES[counter], ts, g_counters[counter], 0, (int)counter });
+    g_mutex_unlock(&g_lock);
+}
+
+static void close_json(void)
+{
+    write_events();
+    fprintf(g_json, "\n]\n");
+    fclose(g_json);
+    g_json = NULL;
+    fprintf(stderr, "[Trace] %llu events written to %s\n", (unsigned long long)g_written, g_json_path);
+}
+
+static void write_summary(void)
+{
+    fprintf(stderr, "\n--- TRACE SUMMARY ---\n");
+    fprintf(stderr, "%-18s %8s %12s %10s %10s\n", "scope", "calls", "total ms", "avg ms", "max ms");
+    for (int i = 0; i < g_nstats; i++) {
+        const TraceStat *s = &g_stats[i];
+        fprintf(stderr, "%-18s %8llu %12.1f %10.3f %10.3f\n", s->name, (unsigned long long)s->calls,
+                s->total_us / 1000.0, s->total_us / 1000.0 / (double)s->calls, s->max_us / 1000.0);
+    }
+    for (int c = 0; c < TRACE_COUNTER_COUNT; c++)
+        fprintf(stderr, "%-18s %21lld\n", COUNTER_NAMES[c], (long long)g_counters[c]);
+}
+
+static void trace_flush(void)
+{
+    g_mutex_lock(&g_lock);
+    if (g_mode == TRACE_JSON) close_json();
+    else write_summary();
+    g_mutex_unlock(&g_lock);
+}
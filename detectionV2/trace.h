@@ -0,0 +1,38 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <glib.h>
+
+// Lightweight instrumentation, off unless OCR_TRACE is set:
+//   OCR_TRACE=summary        per-scope and counter totals on stderr at exit
+//   OCR_TRACE=json[:FILE]    Chrome trace events (chrome://tracing, Perfetto)
+//                            streamed to FILE, default ocr_trace.json
+// Disabled, a scope costs one flag test.
+
+typedef enum
+{
+    TRACE_PIXELS,       // pixels scanned by a pass over an image
+    TRACE_COMPONENTS,   // connected components found
+    TRACE_GLYPHS,       // glyphs classified
+    TRACE_FILES,        // files written
+    TRACE_COUNTER_COUNT
+} TraceCounter;
+
+typedef struct
+{
+    const char *name;   // string literal, also the key of the summary
+    gint64 start;       // 0 when tracing is off
+} TraceScope;
+
+gboolean trace_enabled(void);
+
+TraceScope trace_begin(const char *name);
+void trace_end(TraceScope *scope);
+
+void trace_count(TraceCounter counter, gint64 n);
+
+// Times the rest of the enclosing block.
+#define TRACE_SCOPE(name) \
+    __attribute__((cleanup(trace_end), unused)) TraceScope trace_scope_ = trace_begin(name)
+
+#endif
@@ -0,0 +1,111 @@
+#define _POSIX_C_SOURCE 200809L
+#include <glib.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "workers.h"
+
+typedef struct
+{
+    WorkerFn fn;
+    void *ctx;
+    int n_tasks;
+    volatile gint next;    // next task index to take
+    int helpers;           // helpers still running
+    GMutex lock;
+    GCond done;
+} WorkerJob;
+
+static GThreadPool *g_pool = NULL;
+static int g_nthreads = 1;
+static GPrivate g_serial = G_PRIVATE_INIT(NULL);   // non-NULL: run inline
+
+static void run_tasks(WorkerJob *job)
+{
+    for (;;) {
+        int t = g_atomic_int_add(&job->next, 1);
+        if (t >= job->n_tasks) break;
+        job->fn(t, job->ctx);
+    }
+}
+
+static void helper_main(gpointer data, gpointer user_data)
+{
+    (void)user_data;
+    WorkerJob *job = data;
+    run_tasks(job);
+
+    g_mutex_lock(&job->lock);
+    if (--job->helpers == 0) g_cond_signal(&job->done);
+    g_mutex_unlock(&job->lock);
+}
+
+static void workers_init(void)
+{
+    static gsize once = 0;
+    if (!g_once_init_enter(&once)) return;
+
+    int n = (int)g_get_num_processors();
+    const char *env = g_getenv("OCR_THREADS");
+    if (env && atoi(env) > 0) n = atoi(env);
+    if (n < 1) n = 1;
+    g_nthreads = n;
+
+    // the caller takes part, so the pool only needs n - 1 helpers
+    if (n > 1) {
+        GError *err = NULL;
+        g_pool = g_thread_pool_new(helper_main, NULL, n - 1, FALSE, &err);
+        if (!g_pool) {
+            g_printerr("[Warn] worker pool disabled: %s\n", err ? err->message : "?");
+            g_clear_error(&err);
+            g_nthreads = 1;
+        }
+    }
+    g_once_init_leave(&once, 1);
+}
+
+int workers_count(void)
+{
+    workers_init();
+    return g_nthreads;
+}
+
+size_t workers_memory(void)
+{
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long size = sysconf(_SC_PAGESIZE);
+    if (pages <= 0 || size <= 0) return 0;
+    return (size_t)pages * (size_t)size;
+}
+
+void workers_run(int n_tasks, WorkerFn fn, void *ctx)
+{
+    if (n_tasks <= 0) return;
+    workers_init();
+
+    WorkerJob job = { fn, ctx, n_tasks, 0, 0, {0}, {0} };
+    int helpers = MIN(n_tasks, g_nthreads) - 1;
+    if (!g_pool || helpers <= 0 || g_private_get(&g_serial)) {
+        run_tasks(&job);
+        return;
+    }
+
+    g_mutex_init(&job.lock);
+    g_cond_init(&job.done);
+    job.helpers = helpers;
+    for (int i = 0; i < helpers; i++)
+        g_thread_pool_push(g_pool, &job, NULL);
+
+    run_tasks(&job);
+
+    g_mutex_lock(&job.lock);
+    while (job.helpers > 0) g_cond_wait(&job.done, &job.lock);
+    g_mutex_unlock(&job.lock);
+
+    g_mutex_clear(&job.lock);
+    g_cond_clear(&job.done);
+}
+
+void workers_set_serial(int serial)
+{
+    g_private_set(&g_serial, serial ? GINT_TO_POINTER(1) : NULL);
+}
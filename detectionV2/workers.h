@@ -0,0 +1,21 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <stddef.h>
+
+// Process-wide worker pool, one thread per core (OCR_THREADS overrides it).
+typedef void (*WorkerFn)(int task, void *ctx);
+
+int workers_count(void);
+// Physical memory of the machine in bytes, 0 when unknown.
+size_t workers_memory(void);
+
+// Runs fn(0..n_tasks-1, ctx) on the pool and the calling thread, returns
+// when every task is done. Must not be called from inside a task.
+void workers_run(int n_tasks, WorkerFn fn, void *ctx);
+
+// With serial set, workers_run() called from this thread runs every task
+// itself. For threads that already get one core each (server workers).
+void workers_set_serial(int serial);
+
+#endif
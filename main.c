@@ -12,6 +12,12 @@ int main(int argc, char **argv)
         if (strcmp(argv[1], "detect") == 0 && argc > 2) {
             return detection_run_app(2, &argv[1]);
         }
+        if (strcmp(argv[1], "batch") == 0) {
+            return detection_run_batch(argc - 1, &argv[1]);
+        }
+        if (strcmp(argv[1], "serve") == 0) {
+            return detection_run_server(argc - 1, &argv[1]);
+        }
         if (strcmp(argv[1], "solver") == 0) {
             // CORRECTION : On passe argc - 1 et l'adresse de argv[1]
             // Ainsi dans solver_test, argv[0] devient "solver", argv[1] le fichier, etc.
@@ -0,0 +1,324 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "networks.h"
+
+// brain.bin layout (version 1):
+//   BrainHeader, zero padding up to data_offset (a multiple of
+//   BRAIN_DATA_ALIGN), then the data block exactly as it sits in memory:
+//   biases_h (HIDDEN_STRIDE), biases_o (OUTPUT_STRIDE),
+//   weights_ih_data (NUM_INPUTS x HIDDEN_STRIDE),
+//   weights_ho_data (NUM_HIDDEN x OUTPUT_STRIDE).
+// Every part starts on a 64-byte boundary, so a read-only mapping of the
+// file is used in place by the kernels.
+
+static const char BRAIN_MAGIC[8] = "OCRBRAIN";
+#define BRAIN_VERSION 1u
+#define BRAIN_DTYPE_F64 1u
+#define BRAIN_BYTE_ORDER 0x01020304u
+#define BRAIN_DATA_ALIGN 4096
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    uint32_t byte_order;     // BRAIN_BYTE_ORDER as written by the saving host
+    uint32_t inputs, hidden, outputs;
+    uint32_t hidden_stride, output_stride;
+    uint64_t data_offset;
+    uint64_t data_size;      // bytes
+    uint64_t checksum;       // FNV-1a over the 64-bit words of the data block
+} BrainHeader;
+
+// Offsets in the data block, in doubles.
+#define OFF_BIASES_H 0
+#define OFF_BIASES_O (OFF_BIASES_H + HIDDEN_STRIDE)
+#define OFF_W_IH (OFF_BIASES_O + OUTPUT_STRIDE)
+#define OFF_W_HO (OFF_W_IH + (size_t)NUM_INPUTS * HIDDEN_STRIDE)
+#define DATA_DOUBLES (OFF_W_HO + (size_t)NUM_HIDDEN * OUTPUT_STRIDE)
+
+// Headerless format of the first versions: packed rows, no padding.
+#define LEGACY_DOUBLES ((size_t)NUM_HIDDEN + NUM_OUTPUTS \
+                        + (size_t)NUM_INPUTS * NUM_HIDDEN + (size_t)NUM_HIDDEN * NUM_OUTPUTS)
+
+#define FNV_OFFSET 14695981039346656037ull
+
+static uint64_t fnv_doubles(uint64_t h, const double *data, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        uint64_t w;
+        memcpy(&w, &data[i], sizeof(w));
+        h = (h ^ w) * 1099511628211ull;
+    }
+    return h;
+}
+
+static uint64_t brain_checksum(const double *data, size_t n) {
+    return fnv_doubles(FNV_OFFSET, data, n);
+}
+
+uint64_t network_checksum(const NeuralNetwork *net) {
+    uint64_t h = fnv_doubles(FNV_OFFSET, net->biases_h, NUM_HIDDEN);
+    h = fnv_doubles(h, net->biases_o, NUM_OUTPUTS);
+    for (int i = 0; i < NUM_INPUTS; i++) h = fnv_doubles(h, net->weights_ih[i], NUM_HIDDEN);
+    for (int i = 0; i < NUM_HIDDEN; i++) h = fnv_doubles(h, net->weights_ho[i], NUM_OUTPUTS);
+    return h;
+}
+
+// Save
+
+int atomic_write_file(const char *filename, int (*write_fn)(FILE *f, void *ctx), void *ctx) {
+    // Written next to the target then renamed over it: processes that
+    // still map the old file keep a consistent copy. The temporary name is
+    // unique, so processes saving at the same time never share a file.
+    size_t tmp_len = strlen(filename) + 8;
+    char *tmp = malloc(tmp_len);
+    if (!tmp) {
+        warnx("Erreur Mémoire sauvegarde");
+        return 0;
+    }
+    snprintf(tmp, tmp_len, "%s.XXXXXX", filename);
+
+    int fd = mkstemp(tmp);
+    FILE *f = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (!f) {
+        warn("Impossible d'ouvrir le fichier de sauvegarde %s", tmp);
+        if (fd >= 0) {
+            close(fd);
+            remove(tmp);
+        }
+        free(tmp);
+        return 0;
+    }
+    fchmod(fd, 0644);
+    int ok = write_fn(f, ctx);
+    ok &= fclose(f) == 0;
+
+    if (!ok || rename(tmp, filename) != 0) {
+        warn("Echec de la sauvegarde dans %s", filename);
+        remove(tmp);
+        free(tmp);
+        return 0;
+    }
+    free(tmp);
+    return 1;
+}
+
+typedef struct {
+    BrainHeader h;
+    const double *data;
+} BrainImage;
+
+static int write_brain(FILE *f, void *ctx) {
+    const BrainImage *b = ctx;
+    static const char zeros[BRAIN_DATA_ALIGN];
+    size_t ok = fwrite(&b->h, sizeof(b->h), 1, f) == 1;
+    ok &= fwrite(zeros, 1, BRAIN_DATA_ALIGN - sizeof(b->h), f) == BRAIN_DATA_ALIGN - sizeof(b->h);
+    ok &= fwrite(b->data, sizeof(double), DATA_DOUBLES, f) == DATA_DOUBLES;
+    return (int)ok;
+}
+
+void save_network(NeuralNetwork *net, const char *filename) {
+    double *data = calloc(DATA_DOUBLES, sizeof(double));
+    if (!data) {
+        warnx("Erreur Mémoire sauvegarde");
+        return;
+    }
+    memcpy(data + OFF_BIASES_H, net->biases_h, NUM_HIDDEN * sizeof(double));
+    memcpy(data + OFF_BIASES_O, net->biases_o, NUM_OUTPUTS * sizeof(double));
+    memcpy(data + OFF_W_IH, net->weights_ih_data,
+           (size_t)NUM_INPUTS * HIDDEN_STRIDE * sizeof(double));
+    memcpy(data + OFF_W_HO, net->weights_ho_data,
+           (size_t)NUM_HIDDEN * OUTPUT_STRIDE * sizeof(double));
+
+    BrainImage b;
+    BrainHeader *h = &b.h;
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, BRAIN_MAGIC, sizeof(h->magic));
+    h->version = BRAIN_VERSION;
+    h->dtype = BRAIN_DTYPE_F64;
+    h->byte_order = BRAIN_BYTE_ORDER;
+    h->inputs = NUM_INPUTS;
+    h->hidden = NUM_HIDDEN;
+    h->outputs = NUM_OUTPUTS;
+    h->hidden_stride = HIDDEN_STRIDE;
+    h->output_stride = OUTPUT_STRIDE;
+    h->data_offset = BRAIN_DATA_ALIGN;
+    h->data_size = DATA_DOUBLES * sizeof(double);
+    h->checksum = brain_checksum(data, DATA_DOUBLES);
+    b.data = data;
+
+    int ok = atomic_write_file(filename, write_brain, &b);
+    free(data);
+    if (ok) printf("Network saved to '%s'.\n", filename);
+}
+
+// Load
+
+typedef enum { BRAIN_MISSING, BRAIN_BAD, BRAIN_MAPPED, BRAIN_LEGACY } BrainKind;
+
+// Maps the whole file read-only and checks its header and checksum.
+// On BRAIN_MAPPED *map / *map_size describe the mapping and *data points
+// to the data block inside it.
+static BrainKind map_brain(const char *filename, void **map, size_t *map_size,
+                           const double **data) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT) return BRAIN_MISSING;
+        warn("Error: cannot open save file '%s'", filename);
+        return BRAIN_BAD;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(BrainHeader)) {
+        close(fd);
+        printf("Error: Save file '%s' rejected (truncated).\n", filename);
+        return BRAIN_BAD;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void *p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        warn("Error: cannot map save file '%s'", filename);
+        return BRAIN_BAD;
+    }
+
+    const BrainHeader *h = p;
+    if (memcmp(h->magic, BRAIN_MAGIC, sizeof(h->magic)) != 0) {
+        munmap(p, size);
+        if (size == LEGACY_DOUBLES * sizeof(double)) return BRAIN_LEGACY;
+        printf("Error: Save file '%s' rejected (not a brain file).\n", filename);
+        return BRAIN_BAD;
+    }
+
+    const char *why = NULL;
+    if (h->version != BRAIN_VERSION) why = "unsupported version";
+    else if (h->byte_order != BRAIN_BYTE_ORDER) why = "other byte order";
+    else if (h->dtype != BRAIN_DTYPE_F64) why = "unsupported weight type";
+    else if (h->inputs != NUM_INPUTS || h->hidden != NUM_HIDDEN || h->outputs != NUM_OUTPUTS
+             || h->hidden_stride != HIDDEN_STRIDE || h->output_stride != OUTPUT_STRIDE)
+        why = "layer sizes differ from this build";
+    else if (h->data_offset % WEIGHT_ALIGN != 0 || h->data_size != DATA_DOUBLES * sizeof(double)
+             || h->data_offset > size || size - h->data_offset < h->data_size)
+        why = "truncated";
+    else if (brain_checksum((const double *)((const char *)p + h->data_offset), DATA_DOUBLES)
+             != h->checksum)
+        why = "checksum mismatch";
+    if (why) {
+        printf("Error: Save file '%s' rejected (%s).\n", filename, why);
+        munmap(p, size);
+        return BRAIN_BAD;
+    }
+
+    *map = p;
+    *map_size = size;
+    *data = (const double *)((const char *)p + h->data_offset);
+    return BRAIN_MAPPED;
+}
+
+// Headerless file: one read, then rows are spread to their stride.
+static int load_legacy(NeuralNetwork *net, const char *filename) {
+    FILE *f = fopen(filename, "rb");
+    if (!f) return 0;
+    double *buf = malloc(LEGACY_DOUBLES * sizeof(double));
+    size_t got = buf ? fread(buf, sizeof(double), LEGACY_DOUBLES, f) : 0;
+    fclose(f);
+    if (got != LEGACY_DOUBLES) {
+        printf("Error: Save file appears corrupted or empty.\n");
+        free(buf);
+        return 0;
+    }
+
+    const double *p = buf;
+    memcpy(net->biases_h, p, NUM_HIDDEN * sizeof(double));
+    p += NUM_HIDDEN;
+    memcpy(net->biases_o, p, NUM_OUTPUTS * sizeof(double));
+    p += NUM_OUTPUTS;
+    for (int i = 0; i < NUM_INPUTS; i++, p += NUM_HIDDEN)
+        memcpy(net->weights_ih[i], p, NUM_HIDDEN * sizeof(double));
+    for (int i = 0; i < NUM_HIDDEN; i++, p += NUM_OUTPUTS)
+        memcpy(net->weights_ho[i], p, NUM_OUTPUTS * sizeof(double));
+    free(buf);
+
+    printf("Network loaded from '%s' (legacy format).\n", filename);
+    return 1;
+}
+
+int load_network(NeuralNetwork *net, const char *filename) {
+    void *map;
+    size_t map_size;
+    const double *data;
+    switch (map_brain(filename, &map, &map_size, &data)) {
+    case BRAIN_LEGACY:
+        return load_legacy(net, filename);
+    case BRAIN_MISSING:
+    case BRAIN_BAD:
+        return 0;
+    case BRAIN_MAPPED:
+        break;
+    }
+
+    memcpy(net->biases_h, data + OFF_BIASES_H, NUM_HIDDEN * sizeof(double));
+    memcpy(net->biases_o, data + OFF_BIASES_O, NUM_OUTPUTS * sizeof(double));
+    memcpy(net->weights_ih_data, data + OFF_W_IH,
+           (size_t)NUM_INPUTS * HIDDEN_STRIDE * sizeof(double));
+    memcpy(net->weights_ho_data, data + OFF_W_HO,
+           (size_t)NUM_HIDDEN * OUTPUT_STRIDE * sizeof(double));
+    munmap(map, map_size);
+
+    printf("Network loaded from '%s'.\n", filename);
+    return 1;
+}
+
+int map_network(NeuralNetwork *net, const char *filename) {
+    memset(net, 0, sizeof(*net));
+    void *map;
+    size_t map_size;
+    const double *data;
+    switch (map_brain(filename, &map, &map_size, &data)) {
+    case BRAIN_MISSING:
+    case BRAIN_LEGACY:
+        return 0;
+    case BRAIN_BAD:
+        return -1;
+    case BRAIN_MAPPED:
+        break;
+    }
+
+    net->weights_ih = malloc(NUM_INPUTS * sizeof(double *));
+    net->weights_ho = malloc(NUM_HIDDEN * sizeof(double *));
+    if (!net->weights_ih || !net->weights_ho) {
+        free(net->weights_ih);
+        free(net->weights_ho);
+        munmap(map, map_size);
+        memset(net, 0, sizeof(*net));
+        return 0;
+    }
+
+    // The network is only read from here on: the casts drop a const that
+    // the mapping (PROT_READ) enforces anyway.
+    net->biases_h = (double *)(data + OFF_BIASES_H);
+    net->biases_o = (double *)(data + OFF_BIASES_O);
+    net->weights_ih_data = (double *)(data + OFF_W_IH);
+    net->weights_ho_data = (double *)(data + OFF_W_HO);
+    for (int i = 0; i < NUM_INPUTS; i++)
+        net->weights_ih[i] = net->weights_ih_data + (size_t)i * HIDDEN_STRIDE;
+    for (int i = 0; i < NUM_HIDDEN; i++)
+        net->weights_ho[i] = net->weights_ho_data + (size_t)i * OUTPUT_STRIDE;
+    net->mapping = map;
+    net->mapping_size = map_size;
+
+    printf("Network mapped from '%s'.\n", filename);
+    return 1;
+}
+
+void unmap_network(NeuralNetwork *net) {
+    free(net->weights_ih);
+    free(net->weights_ho);
+    munmap(net->mapping, net->mapping_size);
+    memset(net, 0, sizeof(*net));
+}
@@ -0,0 +1,193 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "kernels.h"
+#include "networks.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+// Scalar
+
+static void axpy_scalar(int n, double a, const double *x, double *y) {
+    for (int i = 0; i < n; i++) y[i] += a * x[i];
+}
+
+static double dot_scalar(int n, const double *x, const double *y) {
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) sum += x[i] * y[i];
+    return sum;
+}
+
+static const DenseKernels SCALAR = { "scalar", axpy_scalar, dot_scalar };
+
+#ifdef HAVE_X86_KERNELS
+
+// SSE2
+
+__attribute__((target("sse2")))
+static void axpy_sse2(int n, double a, const double *x, double *y) {
+    __m128d va = _mm_set1_pd(a);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128d y0 = _mm_loadu_pd(y + i);
+        __m128d y1 = _mm_loadu_pd(y + i + 2);
+        y0 = _mm_add_pd(y0, _mm_mul_pd(va, _mm_loadu_pd(x + i)));
+        y1 = _mm_add_pd(y1, _mm_mul_pd(va, _mm_loadu_pd(x + i + 2)));
+        _mm_storeu_pd(y + i, y0);
+        _mm_storeu_pd(y + i + 2, y1);
+    }
+    for (; i < n; i++) y[i] += a * x[i];
+}
+
+__attribute__((target("sse2")))
+static double dot_sse2(int n, const double *x, const double *y) {
+    __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+        s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(y + i + 2)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(s0, s1));
+    double sum = lanes[0] + lanes[1];
+    for (; i < n; i++) sum += x[i] * y[i];
+    return sum;
+}
+
+static const DenseKernels SSE2 = { "sse2", axpy_sse2, dot_sse2 };
+
+// AVX2 + FMA
+
+__attribute__((target("avx2,fma")))
+static void axpy_avx2(int n, double a, const double *x, double *y) {
+    __m256d va = _mm256_set1_pd(a);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d y0 = _mm256_loadu_pd(y + i);
+        __m256d y1 = _mm256_loadu_pd(y + i + 4);
+        y0 = _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), y0);
+        y1 = _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i + 4), y1);
+        _mm256_storeu_pd(y + i, y0);
+        _mm256_storeu_pd(y + i + 4, y1);
+    }
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+    for (; i < n; i++) y[i] += a * x[i];
+}
+
+__attribute__((target("avx2,fma")))
+static double dot_avx2(int n, const double *x, const double *y) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), s0);
+        s1 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4), s1);
+    }
+    for (; i + 4 <= n; i += 4)
+        s0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), s0);
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(s0, s1));
+    double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++) sum += x[i] * y[i];
+    return sum;
+}
+
+static const DenseKernels AVX2 = { "avx2+fma", axpy_avx2, dot_avx2 };
+
+#endif
+
+// Dispatch
+
+static const DenseKernels *detect_kernels(void) {
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (getenv("OCR_KERNELS_SCALAR")) return &SCALAR;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return &AVX2;
+    if (__builtin_cpu_supports("sse2")) return &SSE2;
+#endif
+    return &SCALAR;
+}
+
+static const DenseKernels *selected = NULL;
+static pthread_once_t selected_once = PTHREAD_ONCE_INIT;
+
+static void select_kernels(void) {
+    selected = detect_kernels();
+}
+
+const DenseKernels *kernels_get(void) {
+    // Pool workers and trainer threads may ask first: chosen once, and
+    // pthread_once publishes the pointer to every thread.
+    pthread_once(&selected_once, select_kernels);
+    return selected;
+}
+
+const DenseKernels *kernels_scalar(void) {
+    return &SCALAR;
+}
+
+// Self check
+
+static int check_one(const DenseKernels *k) {
+    // Layer shapes used by forward_pass / backward_pass, plus odd tails.
+    static const int sizes[] = { NUM_HIDDEN, NUM_OUTPUTS, NUM_INPUTS, 1, 3, 7, 13 };
+    const double tol = 1e-12;
+    int ok = 1;
+
+    for (size_t si = 0; si < sizeof(sizes) / sizeof(sizes[0]); si++) {
+        int n = sizes[si];
+        double *x = malloc(sizeof(double) * n);
+        double *y_ref = malloc(sizeof(double) * n);
+        double *y_vec = malloc(sizeof(double) * n);
+        if (!x || !y_ref || !y_vec) { free(x); free(y_ref); free(y_vec); return 0; }
+
+        for (int i = 0; i < n; i++) {
+            x[i] = ((double)rand() / RAND_MAX) - 0.5;
+            y_ref[i] = y_vec[i] = ((double)rand() / RAND_MAX) - 0.5;
+        }
+        double a = ((double)rand() / RAND_MAX) - 0.5;
+
+        SCALAR.axpy(n, a, x, y_ref);
+        k->axpy(n, a, x, y_vec);
+        double max_err = 0.0;
+        for (int i = 0; i < n; i++) {
+            double e = fabs(y_ref[i] - y_vec[i]);
+            if (e > max_err) max_err = e;
+        }
+
+        double d_ref = SCALAR.dot(n, x, y_ref);
+        double d_vec = k->dot(n, x, y_ref);
+        double d_err = fabs(d_ref - d_vec) / (fabs(d_ref) + 1.0);
+
+        if (max_err > tol || d_err > tol) {
+            printf("  %-9s n=%-5d axpy err %.3g, dot err %.3g  FAIL\n", k->name, n, max_err, d_err);
+            ok = 0;
+        }
+        free(x); free(y_ref); free(y_vec);
+    }
+    return ok;
+}
+
+int kernels_self_check(void) {
+    const DenseKernels *all[3];
+    int count = 0;
+    all[count++] = &SCALAR;
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) all[count++] = &SSE2;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) all[count++] = &AVX2;
+#endif
+
+    int ok = 1;
+    for (int i = 0; i < count; i++) {
+        int r = check_one(all[i]);
+        printf("Kernels %-9s: %s\n", all[i]->name, r ? "OK" : "MISMATCH");
+        ok &= r;
+    }
+    printf("Dispatched kernels: %s\n", kernels_get()->name);
+    return ok;
+}
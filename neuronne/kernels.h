@@ -0,0 +1,21 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+// Dense layer building blocks, vectorized when the CPU allows it.
+typedef struct {
+    const char *name;
+    // y[0..n) += a * x[0..n)
+    void (*axpy)(int n, double a, const double *x, double *y);
+    // sum of x[i] * y[i] for i in [0, n)
+    double (*dot)(int n, const double *x, const double *y);
+} DenseKernels;
+
+// Best kernels for this CPU (AVX2+FMA, then SSE2, then scalar).
+const DenseKernels *kernels_get(void);
+const DenseKernels *kernels_scalar(void);
+
+// Compares every available kernel set against the scalar one on the
+// layer sizes of the network. Returns 1 if all match within tolerance.
+int kernels_self_check(void);
+
+#endif
@@ -0,0 +1,65 @@
+#include <pthread.h>
+#include <unistd.h>
+#include "model.h"
+
+static OcrModel g_model;
+static pthread_once_t g_model_once = PTHREAD_ONCE_INIT;
+
+static void model_release(void) {
+    if (g_model.precision != PRECISION_F64) compact_free(&g_model.compact);
+    cleanup(&g_model.net);
+}
+
+static void model_load(void) {
+    NeuralNetwork *net = &g_model.net;
+
+    // Current format: used in place from a read-only mapping.
+    int mapped = map_network(net, MODEL_BRAIN_FILE);
+    if (mapped == 0) {
+        // no random weights when they come from the file
+        alloc_network(net);
+        if (load_network(net, MODEL_BRAIN_FILE)) {
+            // older headerless save, rewritten so the next run maps it
+            save_network(net, MODEL_BRAIN_FILE);
+        } else if (access(MODEL_BRAIN_FILE, F_OK) != 0) {
+            printf(">>> No save found (%s). Training required...\n", MODEL_BRAIN_FILE);
+            cleanup(net);
+            init_network(net);
+            train_network(net, "neuronne/dataset");
+            save_network(net, MODEL_BRAIN_FILE);
+        } else {
+            mapped = -1;
+        }
+    }
+    // A damaged or mismatched file is never trained over: it may be the
+    // only copy of the weights.
+    if (mapped < 0)
+        errx(1, "%s cannot be used; remove it or run ./ocr_project neuron --train",
+             MODEL_BRAIN_FILE);
+
+    // OCR_PRECISION=f32|i8 selects a reduced precision copy of the network.
+    // For i8, brain.q8 is used when it was quantized from this brain.bin.
+    g_model.precision = precision_from_string(getenv("OCR_PRECISION"));
+    int have_compact = 0;
+    if (g_model.precision == PRECISION_I8 && load_quantized(&g_model.compact, QUANT_BRAIN_FILE)) {
+        have_compact = g_model.compact.source == network_checksum(net);
+        if (have_compact) {
+            printf("Quantized network loaded from '%s'.\n", QUANT_BRAIN_FILE);
+        } else {
+            printf("'%s' was built from another brain.bin, quantizing in memory.\n", QUANT_BRAIN_FILE);
+            compact_free(&g_model.compact);
+        }
+    }
+    if (g_model.precision != PRECISION_F64 && !have_compact
+        && !compact_from_network(net, g_model.precision, &g_model.compact)) {
+        warnx("Reduced precision network unavailable, using f64");
+        g_model.precision = PRECISION_F64;
+    }
+
+    atexit(model_release);
+}
+
+const OcrModel *model_get(void) {
+    pthread_once(&g_model_once, model_load);
+    return &g_model;
+}
@@ -0,0 +1,21 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+#include "networks.h"
+#include "quantize.h"
+
+#define MODEL_BRAIN_FILE "neuronne/brain.bin"
+
+// The recognizer of the process: brain.bin mapped in place (or read, or
+// trained when missing) on the first model_get(), plus the reduced
+// precision copy OCR_PRECISION asks for. Read-only afterwards, so every
+// thread and every puzzle shares it; released at exit.
+typedef struct {
+    NeuralNetwork net;
+    NetPrecision precision;
+    CompactNet compact;      // used when precision != PRECISION_F64
+} OcrModel;
+
+const OcrModel *model_get(void);
+
+#endif
@@ -1,29 +1,82 @@
 #include "networks.h"
+#include "kernels.h"
+#include "quantize.h"
+#include "trainer.h"
+#include "model.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <err.h> // Indispensable pour la fonction errx()
 
+// Value of a training option: a whole number >= 1, or the run stops before
+// anything is trained or saved.
+static int positive_option(const char *name, const char *value) {
+    char *end = NULL;
+    long v = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || v < 1 || v > 1000000000L)
+        errx(1, "%s expects a whole number >= 1, got '%s'", name, value);
+    return (int)v;
+}
+
 void network_test(int argc, char *argv[]) {
+
+    // ./ocr_project neuron --check-kernels : SIMD vs scalar comparison
+    if (argc >= 2 && strcmp(argv[1], "--check-kernels") == 0) {
+        if (!kernels_self_check())
+            errx(1, "Kernel self check failed");
+        return;
+    }
     
     // Initialisation SDL pour charger les images (si utilisé dans predict/preprocess)
     if (SDL_Init(SDL_INIT_VIDEO) < 0)
         errx(1, "Erreur SDL: %s", SDL_GetError());
 
-    NeuralNetwork net;
-    init_network(&net);
-
-    const char *save_file = "neuronne/brain.bin";
+    // ./ocr_project neuron --train [--batch N] [--threads T] [--epochs E] [--lr X]
+    // retrains from scratch with the mini-batch trainer and overwrites the brain
+    if (argc >= 2 && strcmp(argv[1], "--train") == 0) {
+        TrainConfig cfg;
+        train_config_default(&cfg);
+        for (int i = 2; i < argc; i += 2) {
+            if (i + 1 >= argc) errx(1, "Missing value for training option: %s", argv[i]);
+            if (strcmp(argv[i], "--batch") == 0) cfg.batch_size = positive_option(argv[i], argv[i + 1]);
+            else if (strcmp(argv[i], "--threads") == 0) cfg.threads = positive_option(argv[i], argv[i + 1]);
+            else if (strcmp(argv[i], "--epochs") == 0) cfg.epochs = positive_option(argv[i], argv[i + 1]);
+            else if (strcmp(argv[i], "--lr") == 0) {
+                char *end = NULL;
+                cfg.learning_rate = strtod(argv[i + 1], &end);
+                if (end == argv[i + 1] || *end != '\0' || !(cfg.learning_rate > 0.0))
+                    errx(1, "--lr expects a number > 0, got '%s'", argv[i + 1]);
+            }
+            else errx(1, "Unknown training option: %s", argv[i]);
+        }
+        NeuralNetwork net;
+        init_network(&net);
+        train_network_parallel(&net, "neuronne/dataset", &cfg);
+        save_network(&net, MODEL_BRAIN_FILE);
+        cleanup(&net);
+        SDL_Quit();
+        return;
+    }
     
-    // Tentative de chargement du cerveau
-    if (!load_network(&net, save_file)) {
-        printf(">>> No save found (%s). Training required...\n", save_file);
-        
-        // Make sure this folder exists!
-        train_network(&net, "neuronne/dataset"); 
-        
-        save_network(&net, save_file);
-    } else {
-        printf(">>> Brain loaded from '%s'.\n", save_file);
+    // Tentative de chargement du cerveau (mapped, read, or trained if missing)
+    const NeuralNetwork *net = &model_get()->net;
+    printf(">>> Brain loaded from '%s'.\n", MODEL_BRAIN_FILE);
+
+    // ./ocr_project neuron --report : accuracy vs speed of f64 / f32 / i8
+    if (argc >= 2 && strcmp(argv[1], "--report") == 0) {
+        precision_report(net, "neuronne/dataset");
+        SDL_Quit();
+        return;
+    }
+
+    // ./ocr_project neuron --quantize : writes the int8 brain file
+    if (argc >= 2 && strcmp(argv[1], "--quantize") == 0) {
+        CompactNet q;
+        if (!compact_from_network(net, PRECISION_I8, &q))
+            errx(1, "Quantization failed");
+        save_quantized(&q, QUANT_BRAIN_FILE);
+        compact_free(&q);
+        SDL_Quit();
+        return;
     }
 
     // If an argument is given, test the image
@@ -35,7 +88,7 @@ void network_test(int argc, char *argv[]) {
         printf("\n--- IMAGE ANALYSIS ---\n");
         // Make sure predict is well-defined in networks.c
         // If predict is not defined, comment out these lines
-        char result = predict(&net, user_image, &confidence);
+        char result = predict(net, user_image, &confidence);
         
         printf("File: %s\n", user_image);
         printf("Result: %c\n", result);
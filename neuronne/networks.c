@@ -1,4 +1,5 @@
 #include "networks.h"
+#include "kernels.h"
 
 // Maths
 
@@ -33,20 +34,41 @@ void softmax(double *input, int n) {
 
 // Init
 
-void init_network(NeuralNetwork *net) {
-    srand(time(NULL));
+static double *alloc_weights(size_t count) {
+    size_t size = count * sizeof(double);
+    size = (size + WEIGHT_ALIGN - 1) / WEIGHT_ALIGN * WEIGHT_ALIGN;
+    double *block = aligned_alloc(WEIGHT_ALIGN, size);
+    if (!block) errx(1, "Erreur Mémoire Poids");
+    memset(block, 0, size);
+    return block;
+}
 
-    net->hidden_output = (double *)malloc(NUM_HIDDEN * sizeof(double));
-    net->final_output = (double *)malloc(NUM_OUTPUTS * sizeof(double));
+void alloc_network(NeuralNetwork *net) {
+    net->mapping = NULL;
+    net->mapping_size = 0;
 
     net->biases_h = (double *)calloc(NUM_HIDDEN, sizeof(double));
     net->biases_o = (double *)calloc(NUM_OUTPUTS, sizeof(double));
+    if (!net->biases_h || !net->biases_o) errx(1, "Erreur Mémoire Poids");
+
+    net->weights_ih_data = alloc_weights((size_t)NUM_INPUTS * HIDDEN_STRIDE);
+    net->weights_ih = (double **)malloc(NUM_INPUTS * sizeof(double *));
+    net->weights_ho_data = alloc_weights((size_t)NUM_HIDDEN * OUTPUT_STRIDE);
+    net->weights_ho = (double **)malloc(NUM_HIDDEN * sizeof(double *));
+    if (!net->weights_ih || !net->weights_ho) errx(1, "Erreur Mémoire Poids");
+    for (int i = 0; i < NUM_INPUTS; i++)
+        net->weights_ih[i] = net->weights_ih_data + (size_t)i * HIDDEN_STRIDE;
+    for (int i = 0; i < NUM_HIDDEN; i++)
+        net->weights_ho[i] = net->weights_ho_data + (size_t)i * OUTPUT_STRIDE;
+}
+
+void init_network(NeuralNetwork *net) {
+    srand(time(NULL));
+    alloc_network(net);
 
     // Input -> Hidden
     double scale1 = 1.0 / sqrt(NUM_INPUTS);
-    net->weights_ih = (double **)malloc(NUM_INPUTS * sizeof(double *));
     for (int i = 0; i < NUM_INPUTS; i++) {
-        net->weights_ih[i] = (double *)malloc(NUM_HIDDEN * sizeof(double));
         for (int j = 0; j < NUM_HIDDEN; j++) {
             net->weights_ih[i][j] = random_weight() * scale1;
         }
@@ -54,9 +76,7 @@ void init_network(NeuralNetwork *net) {
 
     // Hidden -> Output
     double scale2 = 1.0 / sqrt(NUM_HIDDEN);
-    net->weights_ho = (double **)malloc(NUM_HIDDEN * sizeof(double *));
     for (int i = 0; i < NUM_HIDDEN; i++) {
-        net->weights_ho[i] = (double *)malloc(NUM_OUTPUTS * sizeof(double));
         for (int j = 0; j < NUM_OUTPUTS; j++) {
             net->weights_ho[i][j] = random_weight() * scale2;
         }
@@ -98,6 +118,12 @@ void preprocess_image(const char *filepath, double *input_data) {
     SDL_FreeSurface(dest);
 }
 
+// Same binarization as preprocess_image, for tiles already in memory
+void preprocess_pixels(const unsigned char *gray, double *input_data) {
+    for (int i = 0; i < NUM_INPUTS; i++)
+        input_data[i] = (gray[i] < 200) ? 1.0 : 0.0;
+}
+
 // Loading dataset
 void load_dataset(double inputs[NUM_TRAINING_SETS][NUM_INPUTS],
                   double outputs[NUM_TRAINING_SETS][NUM_OUTPUTS],
@@ -123,33 +149,37 @@ void load_dataset(double inputs[NUM_TRAINING_SETS][NUM_INPUTS],
 
 // neuron
 
-void forward_pass(NeuralNetwork *net, double *inputs) {
-    // 1. Input -> Hidden (Sigmoid)
-    for (int j = 0; j < NUM_HIDDEN; j++) {
-        double sum = net->biases_h[j];
-        for (int k = 0; k < NUM_INPUTS; k++) 
-            sum += inputs[k] * net->weights_ih[k][j];
-        net->hidden_output[j] = sigmoid(sum);
+void forward_pass(const NeuralNetwork *net, NetScratch *scratch, const double *inputs) {
+    const DenseKernels *kern = kernels_get();
+
+    // 1. Input -> Hidden (Sigmoid), row by row so weights stream contiguously
+    double acc[HIDDEN_STRIDE];
+    for (int j = 0; j < NUM_HIDDEN; j++) acc[j] = net->biases_h[j];
+    for (int k = 0; k < NUM_INPUTS; k++) {
+        double x = inputs[k];
+        if (x == 0.0) continue;
+        kern->axpy(NUM_HIDDEN, x, net->weights_ih[k], acc);
     }
+    for (int j = 0; j < NUM_HIDDEN; j++)
+        scratch->hidden_output[j] = sigmoid(acc[j]);
 
     // 2. Hidden -> Output (Raw Logits -> Softmax)
-    for (int j = 0; j < NUM_OUTPUTS; j++) {
-        double sum = net->biases_o[j];
-        for (int k = 0; k < NUM_HIDDEN; k++) 
-            sum += net->hidden_output[k] * net->weights_ho[k][j];
-        net->final_output[j] = sum; 
-    }
+    for (int j = 0; j < NUM_OUTPUTS; j++) scratch->final_output[j] = net->biases_o[j];
+    for (int k = 0; k < NUM_HIDDEN; k++)
+        kern->axpy(NUM_OUTPUTS, scratch->hidden_output[k], net->weights_ho[k], scratch->final_output);
 
-    softmax(net->final_output, NUM_OUTPUTS);
+    softmax(scratch->final_output, NUM_OUTPUTS);
 }
 
-double backward_pass(NeuralNetwork *net, double *inputs, double *targets) {
+double backward_pass(NeuralNetwork *net, const NetScratch *scratch,
+                     const double *inputs, const double *targets) {
+    const DenseKernels *kern = kernels_get();
     double out_deltas[NUM_OUTPUTS];
     double hidden_deltas[NUM_HIDDEN];
     double loss = 0.0;
 
     for (int j = 0; j < NUM_OUTPUTS; j++) {
-        double output = net->final_output[j];
+        double output = scratch->final_output[j];
         if (targets[j] == 1.0) {
             loss -= log(output + 1e-15); 
         }
@@ -158,27 +188,21 @@ double backward_pass(NeuralNetwork *net, double *inputs, double *targets) {
     }
 
     for (int j = 0; j < NUM_HIDDEN; j++) {
-        double err = 0.0;
-        for (int k = 0; k < NUM_OUTPUTS; k++) {
-            err += out_deltas[k] * net->weights_ho[j][k];
-        }
-        hidden_deltas[j] = err * sigmoid_derivative(net->hidden_output[j]);
+        double err = kern->dot(NUM_OUTPUTS, out_deltas, net->weights_ho[j]);
+        hidden_deltas[j] = err * sigmoid_derivative(scratch->hidden_output[j]);
     }
 
-    // update weight Hidden -> Output
-    for (int k = 0; k < NUM_OUTPUTS; k++) {
-        net->biases_o[k] += LEARNING_RATE * out_deltas[k];
-        for (int j = 0; j < NUM_HIDDEN; j++) {
-            net->weights_ho[j][k] += LEARNING_RATE * out_deltas[k] * net->hidden_output[j];
-        }
+    // update weight Hidden -> Output (one rank-1 update, row by row)
+    kern->axpy(NUM_OUTPUTS, LEARNING_RATE, out_deltas, net->biases_o);
+    for (int j = 0; j < NUM_HIDDEN; j++) {
+        kern->axpy(NUM_OUTPUTS, LEARNING_RATE * scratch->hidden_output[j], out_deltas, net->weights_ho[j]);
     }
 
-    // update weight Input -> Hidden
-    for (int k = 0; k < NUM_HIDDEN; k++) {
-        net->biases_h[k] += LEARNING_RATE * hidden_deltas[k];
-        for (int j = 0; j < NUM_INPUTS; j++) {
-            net->weights_ih[j][k] += LEARNING_RATE * hidden_deltas[k] * inputs[j];
-        }
+    // update weight Input -> Hidden (rows of zero inputs do not move)
+    kern->axpy(NUM_HIDDEN, LEARNING_RATE, hidden_deltas, net->biases_h);
+    for (int j = 0; j < NUM_INPUTS; j++) {
+        if (inputs[j] == 0.0) continue;
+        kern->axpy(NUM_HIDDEN, LEARNING_RATE * inputs[j], hidden_deltas, net->weights_ih[j]);
     }
 
     return loss;
@@ -186,17 +210,13 @@ double backward_pass(NeuralNetwork *net, double *inputs, double *targets) {
 
 // Prediction
 
-char predict(NeuralNetwork *net, const char *filepath, double *confidence) {
-    double input[NUM_INPUTS];
-    preprocess_image(filepath, input); 
-    forward_pass(net, input);
-
+static char best_output(const NetScratch *scratch, double *confidence) {
     int max_idx = 0;
-    double max_val = net->final_output[0];
+    double max_val = scratch->final_output[0];
 
     for (int i = 1; i < NUM_OUTPUTS; i++) {
-        if (net->final_output[i] > max_val) {
-            max_val = net->final_output[i];
+        if (scratch->final_output[i] > max_val) {
+            max_val = scratch->final_output[i];
             max_idx = i;
         }
     }
@@ -205,6 +225,68 @@ char predict(NeuralNetwork *net, const char *filepath, double *confidence) {
     return (char)('A' + max_idx);
 }
 
+// Blocked batch inference: each weight row is loaded once per BATCH_TILE
+// samples instead of once per sample, like a small GEMM.
+void predict_batch(const NeuralNetwork *net, const double *inputs, int n,
+                   char *letters, double *confidences) {
+    const DenseKernels *kern = kernels_get();
+    double hidden[BATCH_TILE][HIDDEN_STRIDE];
+    double out[BATCH_TILE][NUM_OUTPUTS];
+
+    for (int s0 = 0; s0 < n; s0 += BATCH_TILE) {
+        int nb = (n - s0 < BATCH_TILE) ? n - s0 : BATCH_TILE;
+        const double *x = inputs + (size_t)s0 * NUM_INPUTS;
+
+        for (int s = 0; s < nb; s++)
+            for (int j = 0; j < NUM_HIDDEN; j++) hidden[s][j] = net->biases_h[j];
+
+        for (int k = 0; k < NUM_INPUTS; k++) {
+            const double *w = net->weights_ih[k];
+            for (int s = 0; s < nb; s++) {
+                double xv = x[(size_t)s * NUM_INPUTS + k];
+                if (xv == 0.0) continue;
+                kern->axpy(NUM_HIDDEN, xv, w, hidden[s]);
+            }
+        }
+
+        for (int s = 0; s < nb; s++) {
+            for (int j = 0; j < NUM_HIDDEN; j++) hidden[s][j] = sigmoid(hidden[s][j]);
+            for (int j = 0; j < NUM_OUTPUTS; j++) out[s][j] = net->biases_o[j];
+        }
+
+        for (int k = 0; k < NUM_HIDDEN; k++) {
+            const double *w = net->weights_ho[k];
+            for (int s = 0; s < nb; s++)
+                kern->axpy(NUM_OUTPUTS, hidden[s][k], w, out[s]);
+        }
+
+        for (int s = 0; s < nb; s++) {
+            softmax(out[s], NUM_OUTPUTS);
+            int best = 0;
+            for (int j = 1; j < NUM_OUTPUTS; j++)
+                if (out[s][j] > out[s][best]) best = j;
+            letters[s0 + s] = (char)('A' + best);
+            if (confidences) confidences[s0 + s] = out[s][best] * 100.0;
+        }
+    }
+}
+
+char predict(const NeuralNetwork *net, const char *filepath, double *confidence) {
+    double input[NUM_INPUTS];
+    NetScratch scratch;
+    preprocess_image(filepath, input); 
+    forward_pass(net, &scratch, input);
+    return best_output(&scratch, confidence);
+}
+
+char predict_pixels(const NeuralNetwork *net, const unsigned char *gray, double *confidence) {
+    double input[NUM_INPUTS];
+    NetScratch scratch;
+    preprocess_pixels(gray, input);
+    forward_pass(net, &scratch, input);
+    return best_output(&scratch, confidence);
+}
+
 void shuffle(int *array, size_t n) {
     if (n > 1) {
         for (size_t i = n - 1; i > 0; i--) {
@@ -236,6 +318,7 @@ void train_network(NeuralNetwork *net, const char *path) {
 
     int indices[NUM_TRAINING_SETS];
     for (int i = 0; i < NUM_TRAINING_SETS; i++) indices[i] = i;
+    NetScratch scratch;
 
     for (int ep = 0; ep < NUM_EPOCHS; ep++) {
         shuffle(indices, NUM_TRAINING_SETS);
@@ -243,8 +326,8 @@ void train_network(NeuralNetwork *net, const char *path) {
         
         for (int i = 0; i < NUM_TRAINING_SETS; i++) {
             int idx = indices[i];
-            forward_pass(net, inputs[idx]);
-            avg_loss += backward_pass(net, inputs[idx], targets[idx]);
+            forward_pass(net, &scratch, inputs[idx]);
+            avg_loss += backward_pass(net, &scratch, inputs[idx], targets[idx]);
             print_bar(ep, i, NUM_TRAINING_SETS, avg_loss / (i+1));
         }
     }
@@ -253,74 +336,19 @@ void train_network(NeuralNetwork *net, const char *path) {
     free(targets);
 }
 
-// Save
-
-void save_network(NeuralNetwork *net, const char *filename) {
-    FILE *f = fopen(filename, "wb");
-    if (!f) {
-        warn("Impossible d'ouvrir le fichier de sauvegarde %s", filename);
+void cleanup(NeuralNetwork *net) {
+    if (net->mapping) {
+        unmap_network(net);
         return;
     }
-    
-    fwrite(net->biases_h, sizeof(double), NUM_HIDDEN, f);
-    fwrite(net->biases_o, sizeof(double), NUM_OUTPUTS, f);
-    
-    for(int i = 0; i < NUM_INPUTS; i++) {
-        fwrite(net->weights_ih[i], sizeof(double), NUM_HIDDEN, f);
-    }
-
-    for(int i = 0; i < NUM_HIDDEN; i++) {
-        fwrite(net->weights_ho[i], sizeof(double), NUM_OUTPUTS, f);
-    }
-    
-    fclose(f);
-    printf("Network saved to '%s'.\n", filename);
-}
-
-int load_network(NeuralNetwork *net, const char *filename) {
-    FILE *f = fopen(filename, "rb");
-    if (!f) return 0; 
-
-    size_t res = 0;
-
-    res += fread(net->biases_h, sizeof(double), NUM_HIDDEN, f);
-    res += fread(net->biases_o, sizeof(double), NUM_OUTPUTS, f);
-    
-    for(int i = 0; i < NUM_INPUTS; i++) {
-        res += fread(net->weights_ih[i], sizeof(double), NUM_HIDDEN, f);
-    }
-
-    for(int i = 0; i < NUM_HIDDEN; i++) {
-        res += fread(net->weights_ho[i], sizeof(double), NUM_OUTPUTS, f);
-    }
-    
-    fclose(f);
-
-    if (res == 0) {
-        printf("Error: Save file appears corrupted or empty.\n");
-        return 0;
-    }
-
-    printf("Network loaded from '%s'.\n", filename);
-    return 1; 
-}
-
-
-void cleanup(NeuralNetwork *net) {
-    free(net->hidden_output); 
-    free(net->final_output);
     free(net->biases_h); 
     free(net->biases_o);
 	
-    for (int i = 0; i < NUM_INPUTS; i++) {
-        free(net->weights_ih[i]);
-    }
     free(net->weights_ih);
+    free(net->weights_ih_data);
 
-    for (int i = 0; i < NUM_HIDDEN; i++) {
-        free(net->weights_ho[i]);
-    }
     free(net->weights_ho);
+    free(net->weights_ho_data);
 }
 
 
@@ -7,6 +7,8 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <dirent.h>
 #include <time.h>
 
@@ -20,32 +22,86 @@
 #define NUM_INPUTS (IMAGE_WIDTH * IMAGE_HEIGHT)
 #define NUM_HIDDEN 64
 #define NUM_OUTPUTS 26
-#define NUM_TRAINING_SETS 26*5
+#define NUM_TRAINING_SETS (26*5)
+
+// weight rows are padded to a whole number of 64-byte cache lines
+#define WEIGHT_ALIGN 64
+#define ROW_STRIDE(n) (((n) + 7) & ~7)
+#define HIDDEN_STRIDE ROW_STRIDE(NUM_HIDDEN)
+#define OUTPUT_STRIDE ROW_STRIDE(NUM_OUTPUTS)
+
+// samples classified together by predict_batch
+#define BATCH_TILE 8
 
 // struct
 typedef struct {
+    // weights_ih[i] / weights_ho[i] point into one contiguous aligned block
     double **weights_ih;
+    double *weights_ih_data;  // NUM_INPUTS x HIDDEN_STRIDE
     double *biases_h;
     
     double **weights_ho;
+    double *weights_ho_data;  // NUM_HIDDEN x OUTPUT_STRIDE
     double *biases_o;
 
-    double *hidden_output;
-    double *final_output;
+    // set by map_network: weights and biases live in a read-only mapping
+    // of the brain file, shared with every process that maps it
+    void *mapping;
+    size_t mapping_size;
 } NeuralNetwork;
 
+// Activations of one forward pass. Kept out of NeuralNetwork so the weights
+// can be shared read-only between threads, each with its own scratch.
+typedef struct {
+    double hidden_output[HIDDEN_STRIDE];
+    double final_output[NUM_OUTPUTS];
+} NetScratch;
+
 // fonction
+// Zeroed weights, for load_network. init_network adds the random start
+// weights of training.
+void alloc_network(NeuralNetwork *net);
 void init_network(NeuralNetwork *net);
+double sigmoid(double x);
+void softmax(double *input, int n);
 void load_dataset(double training_inputs[NUM_TRAINING_SETS][NUM_INPUTS],
                   double training_outputs[NUM_TRAINING_SETS][NUM_OUTPUTS],
                   const char *dataset_path);
 void preprocess_image(const char *filepath, double *input_data);
+void preprocess_pixels(const unsigned char *gray, double *input_data);
+
+void forward_pass(const NeuralNetwork *net, NetScratch *scratch, const double *inputs);
+double backward_pass(NeuralNetwork *net, const NetScratch *scratch,
+                     const double *inputs, const double *targets);
 
+void shuffle(int *array, size_t n);
+void print_bar(int epoch, int current, int total, double loss);
 void train_network(NeuralNetwork *net, const char *dataset_path);
-char predict(NeuralNetwork *net, const char *filepath, double *confidence);
+char predict(const NeuralNetwork *net, const char *filepath, double *confidence);
+// gray: IMAGE_WIDTH x IMAGE_HEIGHT tile, 0 = ink, 255 = paper
+char predict_pixels(const NeuralNetwork *net, const unsigned char *gray, double *confidence);
+// inputs: n x NUM_INPUTS row-major; letters/confidences receive n results
+void predict_batch(const NeuralNetwork *net, const double *inputs, int n,
+                   char *letters, double *confidences);
 
+// brain file (brainfile.c): header with layer sizes, dtype and checksum,
+// then the weights in memory layout at a page-aligned offset.
 void save_network(NeuralNetwork *net, const char *filename);
+// Writes filename with write_fn (nonzero on success) through a uniquely named
+// temporary file renamed over it, so readers and concurrent savers never see
+// a partial file. Returns 1 on success, warns and returns 0 otherwise.
+int atomic_write_file(const char *filename, int (*write_fn)(FILE *f, void *ctx), void *ctx);
+// Fills a network set up by alloc_network / init_network. Also reads the headerless
+// format of older saves.
 int load_network(NeuralNetwork *net, const char *filename);
+// Read-only network used in place from the file, without init_network.
+// Returns 1 when mapped, 0 for a missing or headerless file (see
+// load_network) and -1 for a file that is rejected. cleanup() unmaps it.
+int map_network(NeuralNetwork *net, const char *filename);
+void unmap_network(NeuralNetwork *net);
+// FNV-1a of the biases and weights, padding excluded: tells which network
+// a derived file (brain.q8) was built from.
+uint64_t network_checksum(const NeuralNetwork *net);
 
 void cleanup(NeuralNetwork *net);
 void network_test(int argc, char *argv[]);
@@ -0,0 +1,328 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "quantize.h"
+#include "bitinput.h"
+
+static const char QUANT_MAGIC[8] = "OCRQ8";
+#define QUANT_VERSION 2u   // 2: checksum of the source network
+
+NetPrecision precision_from_string(const char *s) {
+    if (!s) return PRECISION_F64;
+    if (strcmp(s, "f32") == 0) return PRECISION_F32;
+    if (strcmp(s, "i8") == 0) return PRECISION_I8;
+    return PRECISION_F64;
+}
+
+const char *precision_name(NetPrecision p) {
+    switch (p) {
+    case PRECISION_F32: return "f32";
+    case PRECISION_I8:  return "i8";
+    default:            return "f64";
+    }
+}
+
+static void *alloc_block(size_t size) {
+    size = (size + WEIGHT_ALIGN - 1) / WEIGHT_ALIGN * WEIGHT_ALIGN;
+    void *p = aligned_alloc(WEIGHT_ALIGN, size);
+    if (p) memset(p, 0, size);
+    return p;
+}
+
+static int alloc_compact(CompactNet *c, NetPrecision precision) {
+    memset(c, 0, sizeof(*c));
+    c->precision = precision;
+    if (precision == PRECISION_F32) {
+        c->w_ih_f = alloc_block(sizeof(float) * NUM_INPUTS * HIDDEN_STRIDE);
+        c->w_ho_f = alloc_block(sizeof(float) * NUM_HIDDEN * OUTPUT_STRIDE);
+        return c->w_ih_f && c->w_ho_f;
+    }
+    if (precision == PRECISION_I8) {
+        c->w_ih_q = alloc_block(NUM_INPUTS * HIDDEN_STRIDE);
+        c->w_ho_q = alloc_block(NUM_HIDDEN * OUTPUT_STRIDE);
+        return c->w_ih_q && c->w_ho_q;
+    }
+    return 0;
+}
+
+void compact_free(CompactNet *c) {
+    free(c->w_ih_f); free(c->w_ho_f);
+    free(c->w_ih_q); free(c->w_ho_q);
+    memset(c, 0, sizeof(*c));
+}
+
+static float layer_scale(double **w, int rows, int cols) {
+    double max = 0.0;
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < cols; j++)
+            if (fabs(w[i][j]) > max) max = fabs(w[i][j]);
+    return (max > 0.0) ? (float)(max / 127.0) : 1.0f;
+}
+
+static int8_t quantize_weight(double w, float scale) {
+    long q = lrint(w / scale);
+    if (q > 127) q = 127;
+    if (q < -127) q = -127;
+    return (int8_t)q;
+}
+
+int compact_from_network(const NeuralNetwork *net, NetPrecision precision, CompactNet *out) {
+    if (!alloc_compact(out, precision)) {
+        compact_free(out);
+        return 0;
+    }
+
+    out->source = network_checksum(net);
+    for (int j = 0; j < NUM_HIDDEN; j++) out->biases_h[j] = (float)net->biases_h[j];
+    for (int j = 0; j < NUM_OUTPUTS; j++) out->biases_o[j] = (float)net->biases_o[j];
+
+    if (precision == PRECISION_F32) {
+        for (int i = 0; i < NUM_INPUTS; i++)
+            for (int j = 0; j < NUM_HIDDEN; j++)
+                out->w_ih_f[i * HIDDEN_STRIDE + j] = (float)net->weights_ih[i][j];
+        for (int i = 0; i < NUM_HIDDEN; i++)
+            for (int j = 0; j < NUM_OUTPUTS; j++)
+                out->w_ho_f[i * OUTPUT_STRIDE + j] = (float)net->weights_ho[i][j];
+        return 1;
+    }
+
+    out->scale_ih = layer_scale(net->weights_ih, NUM_INPUTS, NUM_HIDDEN);
+    out->scale_ho = layer_scale(net->weights_ho, NUM_HIDDEN, NUM_OUTPUTS);
+    for (int i = 0; i < NUM_INPUTS; i++)
+        for (int j = 0; j < NUM_HIDDEN; j++)
+            out->w_ih_q[i * HIDDEN_STRIDE + j] = quantize_weight(net->weights_ih[i][j], out->scale_ih);
+    for (int i = 0; i < NUM_HIDDEN; i++)
+        for (int j = 0; j < NUM_OUTPUTS; j++)
+            out->w_ho_q[i * OUTPUT_STRIDE + j] = quantize_weight(net->weights_ho[i][j], out->scale_ho);
+    return 1;
+}
+
+// Inference
+
+static void hidden_f32(const CompactNet *c, const double *x, float *h) {
+    for (int j = 0; j < NUM_HIDDEN; j++) h[j] = c->biases_h[j];
+    for (int k = 0; k < NUM_INPUTS; k++) {
+        if (x[k] == 0.0) continue;
+        float xv = (float)x[k];
+        const float *w = c->w_ih_f + k * HIDDEN_STRIDE;
+        for (int j = 0; j < NUM_HIDDEN; j++) h[j] += xv * w[j];
+    }
+}
+
+// Inputs are 0/1 in practice, so set pixels add whole int8 rows into
+// int32 accumulators; any other value falls back to a float term.
+static void hidden_i8(const CompactNet *c, const double *x, float *h) {
+    int32_t acc[HIDDEN_STRIDE] = {0};
+    float extra[HIDDEN_STRIDE] = {0};
+    for (int k = 0; k < NUM_INPUTS; k++) {
+        if (x[k] == 0.0) continue;
+        const int8_t *w = c->w_ih_q + k * HIDDEN_STRIDE;
+        if (x[k] == 1.0) {
+            for (int j = 0; j < NUM_HIDDEN; j++) acc[j] += w[j];
+        } else {
+            float xv = (float)x[k];
+            for (int j = 0; j < NUM_HIDDEN; j++) extra[j] += xv * (float)w[j];
+        }
+    }
+    for (int j = 0; j < NUM_HIDDEN; j++)
+        h[j] = c->biases_h[j] + c->scale_ih * ((float)acc[j] + extra[j]);
+}
+
+void compact_predict_batch(const CompactNet *c, const double *inputs, int n,
+                           char *letters, double *confidences) {
+    float hidden[HIDDEN_STRIDE];
+    double out[NUM_OUTPUTS];
+
+    for (int s = 0; s < n; s++) {
+        const double *x = inputs + (size_t)s * NUM_INPUTS;
+        if (c->precision == PRECISION_I8) hidden_i8(c, x, hidden);
+        else hidden_f32(c, x, hidden);
+
+        for (int j = 0; j < NUM_HIDDEN; j++)
+            hidden[j] = 1.0f / (1.0f + expf(-hidden[j]));
+
+        float o[OUTPUT_STRIDE];
+        for (int j = 0; j < NUM_OUTPUTS; j++) o[j] = c->biases_o[j];
+        for (int k = 0; k < NUM_HIDDEN; k++) {
+            if (c->precision == PRECISION_I8) {
+                const int8_t *w = c->w_ho_q + k * OUTPUT_STRIDE;
+                float hk = hidden[k] * c->scale_ho;
+                for (int j = 0; j < NUM_OUTPUTS; j++) o[j] += hk * (float)w[j];
+            } else {
+                const float *w = c->w_ho_f + k * OUTPUT_STRIDE;
+                for (int j = 0; j < NUM_OUTPUTS; j++) o[j] += hidden[k] * w[j];
+            }
+        }
+
+        for (int j = 0; j < NUM_OUTPUTS; j++) out[j] = o[j];
+        softmax(out, NUM_OUTPUTS);
+        int best = 0;
+        for (int j = 1; j < NUM_OUTPUTS; j++)
+            if (out[j] > out[best]) best = j;
+        letters[s] = (char)('A' + best);
+        if (confidences) confidences[s] = out[best] * 100.0;
+    }
+}
+
+// Quantized file
+
+// Writes the CompactNet ctx to f. Returns 0 on a short write.
+static int write_quantized(FILE *f, void *ctx) {
+    const CompactNet *c = ctx;
+    uint32_t header[4] = { QUANT_VERSION, NUM_INPUTS, NUM_HIDDEN, NUM_OUTPUTS };
+    size_t ok = fwrite(QUANT_MAGIC, 1, sizeof(QUANT_MAGIC), f) == sizeof(QUANT_MAGIC);
+    ok &= fwrite(header, sizeof(uint32_t), 4, f) == 4;
+    ok &= fwrite(&c->source, sizeof(uint64_t), 1, f) == 1;
+    ok &= fwrite(&c->scale_ih, sizeof(float), 1, f) == 1;
+    ok &= fwrite(&c->scale_ho, sizeof(float), 1, f) == 1;
+    ok &= fwrite(c->biases_h, sizeof(float), NUM_HIDDEN, f) == NUM_HIDDEN;
+    ok &= fwrite(c->biases_o, sizeof(float), NUM_OUTPUTS, f) == NUM_OUTPUTS;
+    for (int i = 0; i < NUM_INPUTS; i++)
+        ok &= fwrite(c->w_ih_q + i * HIDDEN_STRIDE, 1, NUM_HIDDEN, f) == NUM_HIDDEN;
+    for (int i = 0; i < NUM_HIDDEN; i++)
+        ok &= fwrite(c->w_ho_q + i * OUTPUT_STRIDE, 1, NUM_OUTPUTS, f) == NUM_OUTPUTS;
+    return (int)ok;
+}
+
+int save_quantized(const CompactNet *c, const char *filename) {
+    if (c->precision != PRECISION_I8) return 0;
+    if (!atomic_write_file(filename, write_quantized, (void *)c)) return 0;
+    printf("Quantized network saved to '%s'.\n", filename);
+    return 1;
+}
+
+int load_quantized(CompactNet *c, const char *filename) {
+    FILE *f = fopen(filename, "rb");
+    if (!f) return 0;
+
+    char magic[sizeof(QUANT_MAGIC)];
+    uint32_t header[4];
+    uint64_t source;
+    if (fread(magic, 1, sizeof(magic), f) != sizeof(magic)
+        || memcmp(magic, QUANT_MAGIC, sizeof(magic)) != 0
+        || fread(header, sizeof(uint32_t), 4, f) != 4
+        || header[0] != QUANT_VERSION || header[1] != NUM_INPUTS
+        || header[2] != NUM_HIDDEN || header[3] != NUM_OUTPUTS
+        || fread(&source, sizeof(uint64_t), 1, f) != 1) {
+        printf("Error: '%s' is not a compatible quantized network.\n", filename);
+        fclose(f);
+        return 0;
+    }
+
+    if (!alloc_compact(c, PRECISION_I8)) {
+        compact_free(c);
+        fclose(f);
+        return 0;
+    }
+    c->source = source;
+
+    size_t ok = fread(&c->scale_ih, sizeof(float), 1, f) == 1;
+    ok &= fread(&c->scale_ho, sizeof(float), 1, f) == 1;
+    ok &= fread(c->biases_h, sizeof(float), NUM_HIDDEN, f) == NUM_HIDDEN;
+    ok &= fread(c->biases_o, sizeof(float), NUM_OUTPUTS, f) == NUM_OUTPUTS;
+    for (int i = 0; i < NUM_INPUTS; i++)
+        ok &= fread(c->w_ih_q + i * HIDDEN_STRIDE, 1, NUM_HIDDEN, f) == NUM_HIDDEN;
+    for (int i = 0; i < NUM_HIDDEN; i++)
+        ok &= fread(c->w_ho_q + i * OUTPUT_STRIDE, 1, NUM_OUTPUTS, f) == NUM_OUTPUTS;
+    fclose(f);
+
+    if (!ok) {
+        printf("Error: Quantized file '%s' is truncated.\n", filename);
+        compact_free(c);
+        return 0;
+    }
+    return 1;
+}
+
+// Report
+
+#define REPORT_ROUNDS 20
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report_line(const char *name, size_t weight_bytes, const char *letters,
+                        double seconds, double base_seconds) {
+    int correct = 0;
+    for (int i = 0; i < NUM_TRAINING_SETS; i++)
+        if (letters[i] == 'A' + i % NUM_OUTPUTS) correct++;
+
+    double us = seconds * 1e6 / ((double)REPORT_ROUNDS * NUM_TRAINING_SETS);
+    printf("%-5s %9.2f KB %9.2f%% %10.2f %8.2fx\n", name, weight_bytes / 1024.0,
+           100.0 * correct / NUM_TRAINING_SETS, us, base_seconds / seconds);
+}
+
+void precision_report(const NeuralNetwork *net, const char *dataset_path) {
+    double (*inputs)[NUM_INPUTS] = malloc(NUM_TRAINING_SETS * sizeof(*inputs));
+    double (*targets)[NUM_OUTPUTS] = malloc(NUM_TRAINING_SETS * sizeof(*targets));
+    if (!inputs || !targets) errx(1, "Erreur Mémoire Dataset");
+    load_dataset(inputs, targets, dataset_path);
+
+    const double *x = &inputs[0][0];
+    char letters[NUM_TRAINING_SETS];
+
+    CompactNet f32, i8, i8_file;
+    if (!compact_from_network(net, PRECISION_F32, &f32)
+        || !compact_from_network(net, PRECISION_I8, &i8))
+        errx(1, "Erreur Mémoire Poids");
+
+    // Round-trip through the quantized file format, in a scratch file so
+    // the report leaves brain.q8 alone.
+    char tmp[] = "/tmp/ocr_report_q8_XXXXXX";
+    int fd = mkstemp(tmp);
+    FILE *f = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (f) {
+        int ok = write_quantized(f, &i8);
+        ok &= fclose(f) == 0;
+        if (ok && load_quantized(&i8_file, tmp)) {
+            compact_free(&i8);
+            i8 = i8_file;
+        }
+        remove(tmp);
+    } else if (fd >= 0) {
+        close(fd);
+        remove(tmp);
+    }
+
+    printf("\n--- PRECISION REPORT (%d images x %d rounds) ---\n", NUM_TRAINING_SETS, REPORT_ROUNDS);
+    printf("%-5s %12s %10s %10s %9s\n", "mode", "weights", "accuracy", "us/glyph", "speedup");
+
+    double t = now_seconds();
+    for (int r = 0; r < REPORT_ROUNDS; r++)
+        predict_batch(net, x, NUM_TRAINING_SETS, letters, NULL);
+    double base = now_seconds() - t;
+    report_line("f64", sizeof(double) * (NUM_INPUTS * NUM_HIDDEN + NUM_HIDDEN * NUM_OUTPUTS),
+                letters, base, base);
+
+    BitInput *bits = malloc(NUM_TRAINING_SETS * sizeof(BitInput));
+    if (!bits) errx(1, "Erreur Mémoire Dataset");
+    for (int i = 0; i < NUM_TRAINING_SETS; i++) bits_from_inputs(inputs[i], &bits[i]);
+    t = now_seconds();
+    for (int r = 0; r < REPORT_ROUNDS; r++)
+        predict_bits_batch(net, bits, NUM_TRAINING_SETS, letters, NULL);
+    report_line("bits", sizeof(double) * (NUM_INPUTS * NUM_HIDDEN + NUM_HIDDEN * NUM_OUTPUTS),
+                letters, now_seconds() - t, base);
+    free(bits);
+
+    t = now_seconds();
+    for (int r = 0; r < REPORT_ROUNDS; r++)
+        compact_predict_batch(&f32, x, NUM_TRAINING_SETS, letters, NULL);
+    report_line("f32", sizeof(float) * (NUM_INPUTS * NUM_HIDDEN + NUM_HIDDEN * NUM_OUTPUTS),
+                letters, now_seconds() - t, base);
+
+    t = now_seconds();
+    for (int r = 0; r < REPORT_ROUNDS; r++)
+        compact_predict_batch(&i8, x, NUM_TRAINING_SETS, letters, NULL);
+    report_line("i8", NUM_INPUTS * NUM_HIDDEN + NUM_HIDDEN * NUM_OUTPUTS,
+                letters, now_seconds() - t, base);
+
+    compact_free(&f32);
+    compact_free(&i8);
+    free(inputs);
+    free(targets);
+}
@@ -0,0 +1,54 @@
+#ifndef QUANTIZE_H
+#define QUANTIZE_H
+
+#include <stdint.h>
+#include "networks.h"
+
+// Reduced precision copies of a trained NeuralNetwork, inference only.
+typedef enum {
+    PRECISION_F64,  // the NeuralNetwork itself
+    PRECISION_F32,
+    PRECISION_I8    // per-layer symmetric scale: w = q * scale
+} NetPrecision;
+
+typedef struct {
+    NetPrecision precision;
+    float biases_h[NUM_HIDDEN];
+    float biases_o[NUM_OUTPUTS];
+
+    // PRECISION_F32, same row layout as the double weights
+    float *w_ih_f;   // NUM_INPUTS x HIDDEN_STRIDE
+    float *w_ho_f;   // NUM_HIDDEN x OUTPUT_STRIDE
+
+    // PRECISION_I8
+    int8_t *w_ih_q;  // NUM_INPUTS x HIDDEN_STRIDE
+    int8_t *w_ho_q;  // NUM_HIDDEN x OUTPUT_STRIDE
+    float scale_ih, scale_ho;
+
+    uint64_t source;  // network_checksum() of the network it was built from
+} CompactNet;
+
+#define QUANT_BRAIN_FILE "neuronne/brain.q8"
+
+// "f64", "f32", "i8" (also the OCR_PRECISION environment variable)
+NetPrecision precision_from_string(const char *s);
+const char *precision_name(NetPrecision p);
+
+// precision must be PRECISION_F32 or PRECISION_I8. Returns 0 on failure.
+int compact_from_network(const NeuralNetwork *net, NetPrecision precision, CompactNet *out);
+void compact_free(CompactNet *c);
+
+// Same contract as predict_batch.
+void compact_predict_batch(const CompactNet *c, const double *inputs, int n,
+                           char *letters, double *confidences);
+
+// int8 brain file: header (with the source checksum) + scales + float
+// biases + int8 weights. Saved through a temporary file renamed over
+// filename, so readers never see a partial file.
+int save_quantized(const CompactNet *c, const char *filename);
+int load_quantized(CompactNet *c, const char *filename);
+
+// Accuracy and speed of f64 / f32 / i8 on the training dataset.
+void precision_report(const NeuralNetwork *net, const char *dataset_path);
+
+#endif
@@ -0,0 +1,232 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <unistd.h>
+#include "trainer.h"
+#include "kernels.h"
+
+// gradient accumulator of one thread
+typedef struct {
+    double *g_ih;        // NUM_INPUTS x HIDDEN_STRIDE
+    double *g_ho;        // NUM_HIDDEN x OUTPUT_STRIDE
+    double g_bh[HIDDEN_STRIDE];
+    double g_bo[OUTPUT_STRIDE];
+    unsigned char *touched; // input rows with a nonzero gradient
+    double loss;
+    NetScratch scratch;
+} GradBuffer;
+
+typedef struct {
+    NeuralNetwork *net;
+    const double (*inputs)[NUM_INPUTS];
+    const double (*targets)[NUM_OUTPUTS];
+    const int *batch;    // sample indices of the current batch
+    int batch_len;
+    int stop;
+    int nthreads;
+    double lr;
+    GradBuffer *grads;
+    pthread_barrier_t start, computed;
+} Trainer;
+
+typedef struct {
+    Trainer *tr;
+    int id;
+} TrainerThread;
+
+static double *alloc_grad(size_t count) {
+    size_t size = (count * sizeof(double) + WEIGHT_ALIGN - 1) / WEIGHT_ALIGN * WEIGHT_ALIGN;
+    double *p = aligned_alloc(WEIGHT_ALIGN, size);
+    if (!p) errx(1, "Erreur Mémoire Gradients");
+    memset(p, 0, size);
+    return p;
+}
+
+// Same maths as backward_pass, accumulated instead of applied.
+static void accumulate_sample(const NeuralNetwork *net, GradBuffer *g,
+                              const double *inputs, const double *targets) {
+    const DenseKernels *kern = kernels_get();
+    double out_deltas[NUM_OUTPUTS];
+    double hidden_deltas[NUM_HIDDEN];
+
+    forward_pass(net, &g->scratch, inputs);
+
+    for (int j = 0; j < NUM_OUTPUTS; j++) {
+        double output = g->scratch.final_output[j];
+        if (targets[j] == 1.0) g->loss -= log(output + 1e-15);
+        out_deltas[j] = targets[j] - output;
+    }
+
+    for (int j = 0; j < NUM_HIDDEN; j++) {
+        double h = g->scratch.hidden_output[j];
+        hidden_deltas[j] = kern->dot(NUM_OUTPUTS, out_deltas, net->weights_ho[j]) * h * (1.0 - h);
+    }
+
+    kern->axpy(NUM_OUTPUTS, 1.0, out_deltas, g->g_bo);
+    for (int j = 0; j < NUM_HIDDEN; j++)
+        kern->axpy(NUM_OUTPUTS, g->scratch.hidden_output[j], out_deltas,
+                   g->g_ho + (size_t)j * OUTPUT_STRIDE);
+
+    kern->axpy(NUM_HIDDEN, 1.0, hidden_deltas, g->g_bh);
+    for (int k = 0; k < NUM_INPUTS; k++) {
+        if (inputs[k] == 0.0) continue;
+        kern->axpy(NUM_HIDDEN, inputs[k], hidden_deltas, g->g_ih + (size_t)k * HIDDEN_STRIDE);
+        g->touched[k] = 1;
+    }
+}
+
+// Each thread sums and applies its own slice of input rows; thread 0 also
+// takes the output layer and the biases. Buffers are zeroed for the next batch.
+static void reduce_and_apply(Trainer *tr, int id) {
+    const DenseKernels *kern = kernels_get();
+    NeuralNetwork *net = tr->net;
+    int T = tr->nthreads;
+    int k0 = (int)((long)NUM_INPUTS * id / T);
+    int k1 = (int)((long)NUM_INPUTS * (id + 1) / T);
+
+    for (int k = k0; k < k1; k++) {
+        for (int t = 0; t < T; t++) {
+            GradBuffer *g = &tr->grads[t];
+            if (!g->touched[k]) continue;
+            double *row = g->g_ih + (size_t)k * HIDDEN_STRIDE;
+            kern->axpy(NUM_HIDDEN, tr->lr, row, net->weights_ih[k]);
+            memset(row, 0, NUM_HIDDEN * sizeof(double));
+            g->touched[k] = 0;
+        }
+    }
+
+    if (id != 0) return;
+    for (int t = 0; t < T; t++) {
+        GradBuffer *g = &tr->grads[t];
+        for (int j = 0; j < NUM_HIDDEN; j++) {
+            double *row = g->g_ho + (size_t)j * OUTPUT_STRIDE;
+            kern->axpy(NUM_OUTPUTS, tr->lr, row, net->weights_ho[j]);
+            memset(row, 0, NUM_OUTPUTS * sizeof(double));
+        }
+        kern->axpy(NUM_HIDDEN, tr->lr, g->g_bh, net->biases_h);
+        kern->axpy(NUM_OUTPUTS, tr->lr, g->g_bo, net->biases_o);
+        memset(g->g_bh, 0, sizeof(g->g_bh));
+        memset(g->g_bo, 0, sizeof(g->g_bo));
+    }
+}
+
+// One batch per round: start barrier, gradients, computed barrier, update.
+// The next start barrier also guarantees the update is finished.
+static void *trainer_thread(void *arg) {
+    TrainerThread *th = arg;
+    Trainer *tr = th->tr;
+    GradBuffer *g = &tr->grads[th->id];
+
+    for (;;) {
+        pthread_barrier_wait(&tr->start);
+        if (tr->stop) break;
+
+        for (int i = th->id; i < tr->batch_len; i += tr->nthreads) {
+            int idx = tr->batch[i];
+            accumulate_sample(tr->net, g, tr->inputs[idx], tr->targets[idx]);
+        }
+
+        pthread_barrier_wait(&tr->computed);
+        reduce_and_apply(tr, th->id);
+    }
+    return NULL;
+}
+
+void train_config_default(TrainConfig *cfg) {
+    cfg->epochs = NUM_EPOCHS;
+    cfg->batch_size = 16;
+    cfg->threads = 0;
+    cfg->learning_rate = LEARNING_RATE;
+}
+
+void train_network_parallel(NeuralNetwork *net, const char *path, const TrainConfig *cfg) {
+    double (*inputs)[NUM_INPUTS] = malloc(NUM_TRAINING_SETS * sizeof(*inputs));
+    double (*targets)[NUM_OUTPUTS] = malloc(NUM_TRAINING_SETS * sizeof(*targets));
+    if (!inputs || !targets) errx(1, "Erreur Mémoire Dataset");
+    load_dataset(inputs, targets, path);
+
+    int batch_size = cfg->batch_size;
+    if (batch_size < 1) batch_size = 1;
+    if (batch_size > NUM_TRAINING_SETS) batch_size = NUM_TRAINING_SETS;
+
+    int nthreads = cfg->threads;
+    if (nthreads <= 0) nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > batch_size) nthreads = batch_size;
+
+    printf("Training: %d epochs, batch %d, %d thread(s), lr %.3f\n",
+           cfg->epochs, batch_size, nthreads, cfg->learning_rate);
+
+    Trainer tr = {0};
+    tr.net = net;
+    tr.inputs = (const double (*)[NUM_INPUTS])inputs;
+    tr.targets = (const double (*)[NUM_OUTPUTS])targets;
+    tr.nthreads = nthreads;
+    tr.lr = cfg->learning_rate;
+    tr.grads = calloc(nthreads, sizeof(GradBuffer));
+    if (!tr.grads) errx(1, "Erreur Mémoire Gradients");
+    for (int t = 0; t < nthreads; t++) {
+        tr.grads[t].g_ih = alloc_grad((size_t)NUM_INPUTS * HIDDEN_STRIDE);
+        tr.grads[t].g_ho = alloc_grad((size_t)NUM_HIDDEN * OUTPUT_STRIDE);
+        tr.grads[t].touched = calloc(NUM_INPUTS, 1);
+        if (!tr.grads[t].touched) errx(1, "Erreur Mémoire Gradients");
+    }
+    pthread_barrier_init(&tr.start, NULL, nthreads);
+    pthread_barrier_init(&tr.computed, NULL, nthreads);
+
+    // the calling thread is worker 0
+    pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+    TrainerThread *args = malloc(nthreads * sizeof(TrainerThread));
+    if (!threads || !args) errx(1, "Erreur Mémoire Threads");
+    for (int t = 0; t < nthreads; t++) {
+        args[t].tr = &tr;
+        args[t].id = t;
+        if (t > 0 && pthread_create(&threads[t], NULL, trainer_thread, &args[t]) != 0)
+            errx(1, "Impossible de créer le thread %d", t);
+    }
+
+    int indices[NUM_TRAINING_SETS];
+    for (int i = 0; i < NUM_TRAINING_SETS; i++) indices[i] = i;
+    int nbatches = (NUM_TRAINING_SETS + batch_size - 1) / batch_size;
+    GradBuffer *g0 = &tr.grads[0];
+
+    for (int ep = 0; ep < cfg->epochs; ep++) {
+        shuffle(indices, NUM_TRAINING_SETS);
+        for (int t = 0; t < nthreads; t++) tr.grads[t].loss = 0.0;
+
+        for (int b = 0; b < nbatches; b++) {
+            tr.batch = indices + b * batch_size;
+            tr.batch_len = NUM_TRAINING_SETS - b * batch_size;
+            if (tr.batch_len > batch_size) tr.batch_len = batch_size;
+
+            pthread_barrier_wait(&tr.start);
+            for (int i = 0; i < tr.batch_len; i += nthreads) {
+                int idx = tr.batch[i];
+                accumulate_sample(net, g0, inputs[idx], targets[idx]);
+            }
+            pthread_barrier_wait(&tr.computed);
+            reduce_and_apply(&tr, 0);
+
+            double loss = 0.0;
+            int seen = b * batch_size + tr.batch_len;
+            for (int t = 0; t < nthreads; t++) loss += tr.grads[t].loss;
+            print_bar(ep, b, nbatches, loss / seen);
+        }
+    }
+
+    tr.stop = 1;
+    pthread_barrier_wait(&tr.start);
+    for (int t = 1; t < nthreads; t++) pthread_join(threads[t], NULL);
+
+    pthread_barrier_destroy(&tr.start);
+    pthread_barrier_destroy(&tr.computed);
+    for (int t = 0; t < nthreads; t++) {
+        free(tr.grads[t].g_ih);
+        free(tr.grads[t].g_ho);
+        free(tr.grads[t].touched);
+    }
+    free(tr.grads);
+    free(threads);
+    free(args);
+    free(inputs);
+    free(targets);
+}
@@ -0,0 +1,18 @@
+#ifndef TRAINER_H
+#define TRAINER_H
+
+#include "networks.h"
+
+// Mini-batch trainer: each batch is split over threads, per-thread
+// gradients are summed and applied once per batch.
+typedef struct {
+    int epochs;
+    int batch_size;
+    int threads;          // 0 = one per core
+    double learning_rate; // applied to the summed batch gradient
+} TrainConfig;
+
+void train_config_default(TrainConfig *cfg);
+void train_network_parallel(NeuralNetwork *net, const char *dataset_path, const TrainConfig *cfg);
+
+#endif
@@ -8,10 +8,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include "ccl.h"
+#include "grayimage.h"
+#include "skew.h"
+#include "rotate.h"
+#include "binarize.h"
+#include "trace.h"
 
 static char selected_image_path[512] = {0};
 static GtkWidget *image_widget = NULL;
 static GtkWidget *scale_widget = NULL;
+static GtkWidget *skew_method_widget = NULL;
 static GtkWidget *main_window = NULL;
 
 // Limit display size to avoid oversized windows
@@ -21,6 +28,13 @@ static const int DISPLAY_MAX_H = 800;
 // Buffers
 static GdkPixbuf *original_pixbuf = NULL;
 static GdkPixbuf *current_display_pixbuf = NULL;
+static GdkPixbuf *preview_pixbuf = NULL;    // original scaled down to the display size
+
+// Slider drags rotate the preview, debounced; the full image is rotated once
+// the slider is released (or before cleaning/saving).
+static const guint PREVIEW_DEBOUNCE_MS = 30;
+static guint preview_source = 0;
+static gboolean display_stale = FALSE;      // current_display_pixbuf behind current_angle
 
 static double current_angle = 0.0;
 static const char *startup_image_path = NULL;
@@ -31,64 +45,6 @@ static int launch_detection_after_quit = 0;
 #define M_PI 3.14159265358979323846
 #endif
 
-// --------------------------------------------------
-// Helper: Memory cleaning
-// --------------------------------------------------
-static void free_pixbuf_data(guchar *data, gpointer user_data)
-{
-    (void)user_data;
-    g_free(data);
-}
-
-// --------------------------------------------------
-// Rotation Logic
-// --------------------------------------------------
-static GdkPixbuf *rotate_pixbuf_any_angle(GdkPixbuf *src, double angle_deg)
-{
-    int src_w = gdk_pixbuf_get_width(src);
-    int src_h = gdk_pixbuf_get_height(src);
-    int channels = gdk_pixbuf_get_n_channels(src);
-    int rowstride = gdk_pixbuf_get_rowstride(src);
-    guchar *src_pixels = gdk_pixbuf_get_pixels(src);
-
-    double angle = angle_deg * M_PI / 180.0;
-    double cos_t = cos(angle);
-    double sin_t = sin(angle);
-
-    int dest_w = src_w;
-    int dest_h = src_h;
-    int dest_rowstride = dest_w * channels;
-    guchar *dest_pixels = g_malloc0(dest_rowstride * dest_h);
-
-    double cx = (src_w - 1) / 2.0;
-    double cy = (src_h - 1) / 2.0;
-
-    for (int y = 0; y < dest_h; y++)
-    {
-        for (int x = 0; x < dest_w; x++)
-        {
-            double dx = x - cx;
-            double dy = y - cy;
-            double sx = cos_t * dx + sin_t * dy + cx;
-            double sy = -sin_t * dx + cos_t * dy + cy;
-
-            int isx = (int)floor(sx);
-            int isy = (int)floor(sy);
-
-            for (int c = 0; c < channels; c++)
-            {
-                guchar val = 255;
-                if (isx >= 0 && isy >= 0 && isx < src_w && isy < src_h)
-                    val = src_pixels[isy * rowstride + isx * channels + c];
-
-                dest_pixels[y * dest_rowstride + x * channels + c] = val;
-            }
-        }
-    }
-
-    return gdk_pixbuf_new_from_data(dest_pixels, GDK_COLORSPACE_RGB, channels == 4, 8, dest_w, dest_h, dest_rowstride, free_pixbuf_data, NULL);
-}
-
 // Create an RGB copy (drops alpha if present).
 static GdkPixbuf *strip_alpha_channel(GdkPixbuf *src)
 {
@@ -123,17 +79,23 @@ static GdkPixbuf *strip_alpha_channel(GdkPixbuf *src)
     return dst;
 }
 
-static void set_image_widget_from_pixbuf(GdkPixbuf *pix)
+static double display_scale(int w, int h)
 {
-    if (!pix || !image_widget) return;
-    int w = gdk_pixbuf_get_width(pix);
-    int h = gdk_pixbuf_get_height(pix);
     double scale = 1.0;
     if (w > DISPLAY_MAX_W || h > DISPLAY_MAX_H) {
         double sx = (double)DISPLAY_MAX_W / (double)w;
         double sy = (double)DISPLAY_MAX_H / (double)h;
         scale = (sx < sy) ? sx : sy;
     }
+    return scale;
+}
+
+static void set_image_widget_from_pixbuf(GdkPixbuf *pix)
+{
+    if (!pix || !image_widget) return;
+    int w = gdk_pixbuf_get_width(pix);
+    int h = gdk_pixbuf_get_height(pix);
+    double scale = display_scale(w, h);
 
     if (scale < 1.0) {
         int nw = (int)(w * scale);
@@ -148,94 +110,100 @@ static void set_image_widget_from_pixbuf(GdkPixbuf *pix)
     gtk_image_set_from_pixbuf(GTK_IMAGE(image_widget), pix);
 }
 
+static void build_preview_pixbuf(void)
+{
+    if (preview_pixbuf) g_object_unref(preview_pixbuf);
+    preview_pixbuf = NULL;
+    if (!original_pixbuf) return;
+
+    int w = gdk_pixbuf_get_width(original_pixbuf);
+    int h = gdk_pixbuf_get_height(original_pixbuf);
+    double scale = display_scale(w, h);
+    if (scale < 1.0)
+        preview_pixbuf = gdk_pixbuf_scale_simple(original_pixbuf, (int)(w * scale),
+                                                 (int)(h * scale), GDK_INTERP_BILINEAR);
+    if (!preview_pixbuf) preview_pixbuf = g_object_ref(original_pixbuf);
+}
+
+static void cancel_preview(void)
+{
+    if (preview_source) g_source_remove(preview_source);
+    preview_source = 0;
+}
+
 static void update_image_rotation(double angle)
 {
     if (!original_pixbuf) return;
     if (current_display_pixbuf) g_object_unref(current_display_pixbuf);
-    current_display_pixbuf = rotate_pixbuf_any_angle(original_pixbuf, angle);
+    current_display_pixbuf = rotate_pixbuf(original_pixbuf, angle, ROTATE_BILINEAR);
     set_image_widget_from_pixbuf(current_display_pixbuf);
 }
 
+// Full resolution rotation for the settled angle, if not done yet.
+static void sync_full_rotation(void)
+{
+    cancel_preview();
+    if (!display_stale) return;
+    display_stale = FALSE;
+    update_image_rotation(current_angle);
+}
+
+static gboolean on_preview_timeout(gpointer user_data)
+{
+    (void)user_data;
+    preview_source = 0;
+    if (!preview_pixbuf) return G_SOURCE_REMOVE;
+    GdkPixbuf *rotated = rotate_pixbuf(preview_pixbuf, current_angle, ROTATE_NEAREST);
+    if (rotated) {
+        gtk_image_set_from_pixbuf(GTK_IMAGE(image_widget), rotated);
+        g_object_unref(rotated);
+    }
+    return G_SOURCE_REMOVE;
+}
+
 static void on_rotation_changed(GtkRange *range, gpointer user_data)
 {
     (void)user_data;
     current_angle = gtk_range_get_value(range);
-    update_image_rotation(current_angle);
+    if (!original_pixbuf) return;
+    display_stale = TRUE;
+    if (!preview_source)
+        preview_source = g_timeout_add(PREVIEW_DEBOUNCE_MS, on_preview_timeout, NULL);
+}
+
+static gboolean on_rotation_released(GtkWidget *widget, GdkEvent *event, gpointer user_data)
+{
+    (void)widget; (void)event; (void)user_data;
+    sync_full_rotation();
+    return FALSE;
 }
 
 // --------------------------------------------------
 // Auto-Rotation
 // --------------------------------------------------
-static double detect_skew_angle(GdkPixbuf *pixbuf)
+static double detect_skew_angle(GdkPixbuf *pixbuf, SkewMethod method)
 {
-    int w = gdk_pixbuf_get_width(pixbuf);
-    int h = gdk_pixbuf_get_height(pixbuf);
-    int rowstride = gdk_pixbuf_get_rowstride(pixbuf);
-    int channels = gdk_pixbuf_get_n_channels(pixbuf);
-    guchar *pixels = gdk_pixbuf_get_pixels(pixbuf);
-
-    unsigned char *edges = g_malloc0(w * h);
-    for (int y = 1; y < h - 1; y++) {
-        for (int x = 1; x < w - 1; x++) {
-            guchar *p = pixels + y * rowstride + x * channels;
-            int gray = (p[0] + p[1] + p[2]) / 3;
-            guchar *p_down = pixels + (y + 1) * rowstride + x * channels;
-            int grad = abs((int)(p_down[0] + p_down[1] + p_down[2]) / 3 - gray);
-            if (grad > 50) edges[y * w + x] = 255;
-        }
-    }
-
-    int num_thetas = 180; 
-    double theta_step = 1.0; 
-    double start_theta = -90.0;
-    int max_rho = (int)sqrt(w * w + h * h);
-    int num_rhos = max_rho * 2;
-    int *accumulator = g_malloc0(sizeof(int) * num_thetas * num_rhos);
-    
-    for (int y = 0; y < h; y += 2) {
-        for (int x = 0; x < w; x += 2) {
-            if (edges[y * w + x] > 0) {
-                for (int t = 0; t < num_thetas; t++) {
-                    double theta = (start_theta + t * theta_step) * M_PI / 180.0;
-                    double rho = x * cos(theta) + y * sin(theta);
-                    int rho_idx = (int)rho + max_rho;
-                    if (rho_idx >= 0 && rho_idx < num_rhos) {
-                        accumulator[t * num_rhos + rho_idx]++;
-                    }
-                }
-            }
-        }
-    }
-
-    int max_votes = 0;
-    int best_theta_idx = 0;
-    for (int t = 0; t < num_thetas; t++) {
-        for (int r = 0; r < num_rhos; r++) {
-            if (accumulator[t * num_rhos + r] > max_votes) {
-                max_votes = accumulator[t * num_rhos + r];
-                best_theta_idx = t;
-            }
-        }
-    }
-
-    double best_theta = start_theta + best_theta_idx * theta_step;
-    double correction = 0;
-
-    if (fabs(best_theta - 90) < 45) correction = 90 - best_theta;
-    else if (fabs(best_theta + 90) < 45) correction = -90 - best_theta;
-    else correction = -best_theta;
-
-    g_free(edges);
-    g_free(accumulator);
-    return correction;
+    GrayImage gray;
+    gray_image_init(&gray);
+    if (!gray_image_from_pixbuf(&gray, pixbuf, GRAY_AVG)) return 0.0;
+    gint64 t = g_get_monotonic_time();
+    SkewResult r = skew_estimate(&gray, method, g_getenv("OCR_SKEW_THIN") != NULL);
+    t = g_get_monotonic_time() - t;
+    gray_image_free(&gray);
+    printf("[Skew] %s: %.1f deg (confidence %.2f) in %.1f ms\n",
+           skew_method_name(method), r.angle, r.confidence, t / 1000.0);
+    return r.angle;
 }
 
 static void on_auto_rotate_clicked(GtkWidget *widget, gpointer user_data)
 {
     (void)widget; (void)user_data;
     if (!original_pixbuf) return;
-    double skew = detect_skew_angle(original_pixbuf);
+    SkewMethod method = SKEW_HOUGH;
+    skew_method_from_string(gtk_combo_box_get_active_id(GTK_COMBO_BOX(skew_method_widget)), &method);
+    double skew = detect_skew_angle(original_pixbuf, method);
     gtk_range_set_value(GTK_RANGE(scale_widget), skew);
+    sync_full_rotation();
 }
 
 static void load_image_from_file(const char *f)
@@ -246,6 +214,8 @@ static void load_image_from_file(const char *f)
     if (current_display_pixbuf) g_object_unref(current_display_pixbuf);
 
     original_pixbuf = gdk_pixbuf_new_from_file(f, NULL);
+    current_display_pixbuf = NULL;
+    build_preview_pixbuf();
     if (original_pixbuf) {
         current_display_pixbuf = gdk_pixbuf_copy(original_pixbuf);
         set_image_widget_from_pixbuf(current_display_pixbuf);
@@ -253,13 +223,44 @@ static void load_image_from_file(const char *f)
 
         gtk_range_set_value(GTK_RANGE(scale_widget), 0.0);
     }
+    // the copy above already is the unrotated page
+    cancel_preview();
+    display_stale = FALSE;
 }
 
 // --------------------------------------------------
 // Binarization (Noir & Blanc)
 // --------------------------------------------------
+// Otsu or Sauvola mask from the shared binarization (OCR_BINARIZE).
+static gboolean apply_mask_black_and_white(GdkPixbuf *pixbuf, BinMethod method)
+{
+    GrayImage gray;
+    BitImage mask;
+    gray_image_init(&gray);
+    bit_image_init(&mask);
+    if (!gray_image_from_pixbuf(&gray, pixbuf, GRAY_LUMA)) return FALSE;
+    binarize(&gray, method, &mask);
+
+    int channels = gdk_pixbuf_get_n_channels(pixbuf);
+    int rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+    guchar *pixels = gdk_pixbuf_get_pixels(pixbuf);
+    for (int y = 0; y < mask.h; y++) {
+        for (int x = 0; x < mask.w; x++) {
+            guchar *p = pixels + y * rowstride + x * channels;
+            p[0] = p[1] = p[2] = bit_at(&mask, x, y) ? 0 : 255;
+            if (channels == 4) p[3] = 255;
+        }
+    }
+    gray_image_free(&gray);
+    bit_image_free(&mask);
+    return TRUE;
+}
+
 static void apply_black_and_white(GdkPixbuf *pixbuf)
 {
+    BinMethod method = bin_method_from_env();
+    if (method != BIN_NONE && apply_mask_black_and_white(pixbuf, method)) return;
+
     int w = gdk_pixbuf_get_width(pixbuf);
     int h = gdk_pixbuf_get_height(pixbuf);
     int channels = gdk_pixbuf_get_n_channels(pixbuf);
@@ -294,16 +295,13 @@ static void apply_black_and_white(GdkPixbuf *pixbuf)
 // --------------------------------------------------
 static void remove_large_blobs_fixed(GdkPixbuf *pixbuf)
 {
+    TRACE_SCOPE("clean");
     int w = gdk_pixbuf_get_width(pixbuf);
     int h = gdk_pixbuf_get_height(pixbuf);
     int channels = gdk_pixbuf_get_n_channels(pixbuf);
     int rowstride = gdk_pixbuf_get_rowstride(pixbuf);
     guchar *pixels = gdk_pixbuf_get_pixels(pixbuf);
 
-    unsigned char *visited = g_malloc0(w * h);
-    int *stack = NULL;
-    int stack_cap = 0;
-
     int min_area = 35000; // FIXE
 
     // 15% of the image (to protect the grid if it's giant)
@@ -311,88 +309,40 @@ static void remove_large_blobs_fixed(GdkPixbuf *pixbuf)
 
     printf("\n--- CLEANING (Seuil FIXE: %d) ---\n", min_area);
 
-    for (int y = 0; y < h; y++) {
-        for (int x = 0; x < w; x++) {
-            int idx = y * w + x;
-            if (visited[idx]) continue;
-            guchar *p = pixels + y * rowstride + x * channels;
-            if (p[0] != 0) { visited[idx] = 1; continue; }
-
-            int sp = 0;
-            if (stack_cap == 0) {
-                stack_cap = 65536;
-                stack = (int *)g_malloc(sizeof(int) * stack_cap);
-            }
+    CclLabeler *ccl = ccl_thread_labeler();
+    guint8 *mask = ccl_mask(ccl, w, h);
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            mask[y * w + x] = pixels[y * rowstride + x * channels] == 0;
+
+    // SCAN (components come out in the order the raster scan meets them)
+    int count = ccl_label(ccl, mask, w, h, w);
+    guint8 *doomed = g_malloc0(count + 1);
+    int any = 0;
+    for (int i = 0; i < count; i++) {
+        int area = ccl->comps[i].area;
+        if (area < min_area) continue;
+        if (area > safe_size) {
+            printf("  [PROTECTED] Main Grid/Frame detected (Area: %d)\n", area);
+        } else {
+            printf("  [DELETED]   Large Blob (Area: %d)\n", area);
+            doomed[i + 1] = 1;
+            any = 1;
+        }
+    }
 
-            stack[sp++] = idx;
-            visited[idx] = 1;
-            int area = 0;
-            int min_x = x, max_x = x, min_y = y, max_y = y;
-
-            // SCAN
-            while (sp > 0) {
-                int cur = stack[--sp];
-                area++;
-                int cy = cur / w; int cx = cur % w;
-
-                if (cx < min_x) min_x = cx; 
-                if (cx > max_x) max_x = cx;
-                if (cy < min_y) min_y = cy; 
-                if (cy > max_y) max_y = cy;
-
-                const int nx[4] = {-1, 1, 0, 0}; const int ny[4] = {0, 0, -1, 1};
-                for (int k = 0; k < 4; k++) {
-                    int nx_x = cx + nx[k]; int ny_y = cy + ny[k];
-                    if (nx_x < 0 || nx_x >= w || ny_y < 0 || ny_y >= h) continue;
-                    int nidx = ny_y * w + nx_x;
-                    if (visited[nidx]) continue;
-                    guchar *pn = pixels + ny_y * rowstride + nx_x * channels;
-                    if (pn[0] == 0) {
-                         if (sp >= stack_cap) {
-                            stack_cap *= 2;
-                            stack = (int *)g_realloc(stack, sizeof(int) * stack_cap);
-                        }
-                        stack[sp++] = nidx;
-                        visited[nidx] = 1;
-                    }
-                }
-            }
-
-            // SUPPRESSION (Si > 35000 et pas gigantesque comme la grille)
-            if (area >= min_area) {
-                if (area > safe_size) {
-                    printf("  [PROTECTED] Main Grid/Frame detected (Area: %d)\n", area);
-                } else {
-                    printf("  [DELETED]   Large Blob (Area: %d)\n", area);
-                    
-                    sp = 0; stack[sp++] = y * w + x;
-                    guchar *seed = pixels + y * rowstride + x * channels;
-                    seed[0] = seed[1] = seed[2] = 255; 
-                    
-                    while (sp > 0) {
-                        int cur = stack[--sp];
-                        int cy = cur / w; int cx = cur % w;
-                        const int nx[4] = {-1, 1, 0, 0}; const int ny[4] = {0, 0, -1, 1};
-                        for (int k = 0; k < 4; k++) {
-                            int nx_x = cx + nx[k]; int ny_y = cy + ny[k];
-                            if (nx_x < 0 || nx_x >= w || ny_y < 0 || ny_y >= h) continue;
-                            guchar *pn = pixels + ny_y * rowstride + nx_x * channels;
-                            if (pn[0] == 0) {
-                                pn[0] = pn[1] = pn[2] = 255; if (channels == 4) pn[3] = 255;
-                                if (sp >= stack_cap) {
-                                    stack_cap *= 2;
-                                    stack = (int *)g_realloc(stack, sizeof(int) * stack_cap);
-                                }
-                                stack[sp++] = ny_y * w + nx_x;
-                            }
-                        }
-                    }
-                }
+    // SUPPRESSION (Si > 35000 et pas gigantesque comme la grille)
+    if (any) {
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                if (!doomed[ccl->labels[y * w + x]]) continue;
+                guchar *p = pixels + y * rowstride + x * channels;
+                p[0] = p[1] = p[2] = 255; if (channels == 4) p[3] = 255;
             }
         }
     }
-    if (stack) g_free(stack);
-    g_free(visited);
+
+    g_free(doomed);
 }
 
 // --------------------------------------------------
@@ -488,8 +438,14 @@ static void on_clean_clicked(GtkWidget *widget, gpointer user_data)
         return;
     }
 
+    cancel_preview();
+    display_stale = FALSE;
     if (current_display_pixbuf) g_object_unref(current_display_pixbuf);
-    current_display_pixbuf = rotate_pixbuf_any_angle(original_pixbuf, current_angle);
+    current_display_pixbuf = rotate_pixbuf(original_pixbuf, current_angle, ROTATE_BILINEAR);
+    if (!current_display_pixbuf) {
+        printf("[Error] Could not rotate the image.\n");
+        return;
+    }
 
     // 1. Noir et Blanc
     apply_black_and_white(current_display_pixbuf);
@@ -506,6 +462,7 @@ static void on_clean_clicked(GtkWidget *widget, gpointer user_data)
 static void on_save_clicked(GtkWidget *widget, gpointer user_data)
 {
     (void)widget; (void)user_data;
+    sync_full_rotation();
     if (!current_display_pixbuf) {
         printf("[Error] No image to save.\n");
         return;
@@ -592,6 +549,8 @@ void run_gui(int argc, char *argv[])
     scale_widget = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL, -45, 45, 0.1);
     gtk_box_pack_start(GTK_BOX(box), scale_widget, FALSE, FALSE, 0);
     g_signal_connect(scale_widget, "value-changed", G_CALLBACK(on_rotation_changed), NULL);
+    g_signal_connect(scale_widget, "button-release-event", G_CALLBACK(on_rotation_released), NULL);
+    g_signal_connect(scale_widget, "key-release-event", G_CALLBACK(on_rotation_released), NULL);
 
     // Boutons
     GtkWidget *hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
@@ -606,6 +565,12 @@ void run_gui(int argc, char *argv[])
     g_signal_connect(btn_auto, "clicked", G_CALLBACK(on_auto_rotate_clicked), NULL);
     gtk_box_pack_start(GTK_BOX(hbox), btn_auto, FALSE, FALSE, 5);
 
+    skew_method_widget = gtk_combo_box_text_new();
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(skew_method_widget), "hough", "Hough");
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(skew_method_widget), "profile", "Profile");
+    gtk_combo_box_set_active_id(GTK_COMBO_BOX(skew_method_widget), "hough");
+    gtk_box_pack_start(GTK_BOX(hbox), skew_method_widget, FALSE, FALSE, 5);
+
     GtkWidget *btn_clean = gtk_button_new_with_label("Clean");
     g_signal_connect(btn_clean, "clicked", G_CALLBACK(on_clean_clicked), NULL);
     gtk_box_pack_start(GTK_BOX(hbox), btn_clean, FALSE, FALSE, 5);
@@ -0,0 +1,158 @@
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <math.h>
+#include "rotate.h"
+#include "workers.h"
+#include "trace.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define ROT_TILE 64
+#define FIX_SHIFT 16
+#define FIX_ONE (1 << FIX_SHIFT)
+
+typedef struct
+{
+    const guchar *src;
+    guchar *dst;
+    int w, h, n;                 // size and bytes per pixel of both planes
+    int src_stride, dst_stride;
+    RotateInterp interp;
+    double cos_t, sin_t, cx, cy;
+    int tiles_x;
+} RotateJob;
+
+static inline int src_or_white(const RotateJob *j, int x, int y, int c)
+{
+    if (x < 0 || y < 0 || x >= j->w || y >= j->h) return 255;
+    return j->src[(gsize)y * j->src_stride + (gsize)x * j->n + c];
+}
+
+// Source position of destination pixel (x, y), in 16.16 fixed point. Computed
+// in double once per tile row, then stepped by (cos, -sin) along the row.
+static void row_start(const RotateJob *j, int x, int y, gint64 *fx, gint64 *fy)
+{
+    double dx = x - j->cx;
+    double dy = y - j->cy;
+    *fx = (gint64)floor((j->cos_t * dx + j->sin_t * dy + j->cx) * FIX_ONE);
+    *fy = (gint64)floor((-j->sin_t * dx + j->cos_t * dy + j->cy) * FIX_ONE);
+}
+
+static void rotate_row_nearest(const RotateJob *j, guchar *d, int len,
+                               gint64 fx, gint64 fy, gint64 sx, gint64 sy)
+{
+    int n = j->n;
+    for (int i = 0; i < len; i++, fx += sx, fy += sy, d += n) {
+        int ix = (int)(fx >> FIX_SHIFT);
+        int iy = (int)(fy >> FIX_SHIFT);
+        if (ix >= 0 && iy >= 0 && ix < j->w && iy < j->h) {
+            const guchar *s = j->src + (gsize)iy * j->src_stride + (gsize)ix * n;
+            for (int c = 0; c < n; c++) d[c] = s[c];
+        } else {
+            for (int c = 0; c < n; c++) d[c] = 255;
+        }
+    }
+}
+
+static void rotate_row_bilinear(const RotateJob *j, guchar *d, int len,
+                                gint64 fx, gint64 fy, gint64 sx, gint64 sy)
+{
+    int n = j->n;
+    for (int i = 0; i < len; i++, fx += sx, fy += sy, d += n) {
+        int ix = (int)(fx >> FIX_SHIFT);
+        int iy = (int)(fy >> FIX_SHIFT);
+        // 8-bit weights, the four of them sum to 1 << 16
+        int ax = (int)(fx >> (FIX_SHIFT - 8)) & 255;
+        int ay = (int)(fy >> (FIX_SHIFT - 8)) & 255;
+        int w00 = (256 - ax) * (256 - ay), w10 = ax * (256 - ay);
+        int w01 = (256 - ax) * ay, w11 = ax * ay;
+
+        if (ix >= 0 && iy >= 0 && ix + 1 < j->w && iy + 1 < j->h) {
+            const guchar *s0 = j->src + (gsize)iy * j->src_stride + (gsize)ix * n;
+            const guchar *s1 = s0 + j->src_stride;
+            for (int c = 0; c < n; c++)
+                d[c] = (guchar)((s0[c] * w00 + s0[c + n] * w10
+                                 + s1[c] * w01 + s1[c + n] * w11 + 32768) >> 16);
+        } else if (ix < -1 || iy < -1 || ix >= j->w || iy >= j->h) {
+            for (int c = 0; c < n; c++) d[c] = 255;
+        } else {
+            // border: missing neighbours count as white
+            for (int c = 0; c < n; c++)
+                d[c] = (guchar)((src_or_white(j, ix, iy, c) * w00
+                                 + src_or_white(j, ix + 1, iy, c) * w10
+                                 + src_or_white(j, ix, iy + 1, c) * w01
+                                 + src_or_white(j, ix + 1, iy + 1, c) * w11 + 32768) >> 16);
+        }
+    }
+}
+
+static void rotate_tile(int task, void *ctx)
+{
+    const RotateJob *j = ctx;
+    int x0 = (task % j->tiles_x) * ROT_TILE;
+    int y0 = (task / j->tiles_x) * ROT_TILE;
+    int x1 = MIN(x0 + ROT_TILE, j->w);
+    int y1 = MIN(y0 + ROT_TILE, j->h);
+    gint64 sx = (gint64)llround(j->cos_t * FIX_ONE);
+    gint64 sy = (gint64)llround(-j->sin_t * FIX_ONE);
+
+    for (int y = y0; y < y1; y++) {
+        gint64 fx, fy;
+        row_start(j, x0, y, &fx, &fy);
+        guchar *d = j->dst + (gsize)y * j->dst_stride + (gsize)x0 * j->n;
+        if (j->interp == ROTATE_BILINEAR)
+            rotate_row_bilinear(j, d, x1 - x0, fx, fy, sx, sy);
+        else
+            rotate_row_nearest(j, d, x1 - x0, fx, fy, sx, sy);
+    }
+}
+
+static void rotate_plane(RotateJob *j, double angle_deg)
+{
+    TRACE_SCOPE("rotate");
+    trace_count(TRACE_PIXELS, (gint64)j->w * j->h);
+    double angle = angle_deg * M_PI / 180.0;
+    j->cos_t = cos(angle);
+    j->sin_t = sin(angle);
+    j->cx = (j->w - 1) / 2.0;
+    j->cy = (j->h - 1) / 2.0;
+    j->tiles_x = (j->w + ROT_TILE - 1) / ROT_TILE;
+    int tiles_y = (j->h + ROT_TILE - 1) / ROT_TILE;
+    workers_run(j->tiles_x * tiles_y, rotate_tile, j);
+}
+
+GdkPixbuf *rotate_pixbuf(const GdkPixbuf *src, double angle_deg, RotateInterp interp)
+{
+    int w = gdk_pixbuf_get_width(src);
+    int h = gdk_pixbuf_get_height(src);
+    int channels = gdk_pixbuf_get_n_channels(src);
+
+    GdkPixbuf *dst = gdk_pixbuf_new(GDK_COLORSPACE_RGB, channels == 4, 8, w, h);
+    if (!dst) return NULL;
+
+    RotateJob j = {
+        .src = gdk_pixbuf_get_pixels(src),
+        .dst = gdk_pixbuf_get_pixels(dst),
+        .w = w, .h = h, .n = channels,
+        .src_stride = gdk_pixbuf_get_rowstride(src),
+        .dst_stride = gdk_pixbuf_get_rowstride(dst),
+        .interp = interp,
+    };
+    rotate_plane(&j, angle_deg);
+    return dst;
+}
+
+void rotate_gray(const GrayImage *src, GrayImage *dst, double angle_deg, RotateInterp interp)
+{
+    gray_image_resize(dst, src->w, src->h);
+    RotateJob j = {
+        .src = src->data,
+        .dst = dst->data,
+        .w = src->w, .h = src->h, .n = 1,
+        .src_stride = src->w,
+        .dst_stride = src->w,
+        .interp = interp,
+    };
+    rotate_plane(&j, angle_deg);
+}
@@ -0,0 +1,22 @@
+#ifndef ROTATE_H
+#define ROTATE_H
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include "grayimage.h"
+
+typedef enum
+{
+    ROTATE_NEAREST,      // cheap, for live previews
+    ROTATE_BILINEAR      // smoother glyph edges
+} RotateInterp;
+
+// Rotates src around its center by angle_deg (the value of the rotation
+// slider). Same size as src, uncovered pixels are white. The page is cut in
+// tiles shared with the worker pool.
+GdkPixbuf *rotate_pixbuf(const GdkPixbuf *src, double angle_deg, RotateInterp interp);
+
+// Same rotation on a gray plane; dst is resized to src (its buffer is reused)
+// and must not be src.
+void rotate_gray(const GrayImage *src, GrayImage *dst, double angle_deg, RotateInterp interp);
+
+#endif
@@ -0,0 +1,247 @@
+#include <glib.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "skew.h"
+#include "trace.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define EDGE_THR 50
+#define COARSE_STEPS 180      // 1 degree over [-90, 90)
+#define FINE_STEPS 21         // 0.1 degree over [peak - 1, peak + 1]
+#define PROFILE_INK_THR 128
+#define PROFILE_RANGE 45      // degrees each side
+#define PROFILE_SHIFT 16      // fixed point of the rotated coordinate
+
+typedef struct
+{
+    int x, y;
+} EdgePoint;
+
+// Sampled edge pixels of the vertical gradient, in raster order.
+static EdgePoint *collect_edges(const GrayImage *g, gboolean thin, int *count)
+{
+    int w = g->w, h = g->h;
+    int cap = 1024, n = 0;
+    EdgePoint *pts = g_malloc(sizeof(EdgePoint) * cap);
+
+    // Every other row and column like the plain edge map; thinning already
+    // keeps a single row per border so it scans all rows.
+    int ystep = thin ? 1 : 2;
+    for (int y = ystep; y < h - 1; y += ystep) {
+        const guint8 *row = gray_row(g, y);
+        const guint8 *down = gray_row(g, y + 1);
+        const guint8 *up = gray_row(g, y - 1);
+        const guint8 *down2 = y + 2 < h ? gray_row(g, y + 2) : NULL;
+        for (int x = 2; x < w - 1; x += 2) {
+            int d = abs((int)down[x] - (int)row[x]);
+            if (d <= EDGE_THR) continue;
+            if (thin) {
+                int dp = abs((int)row[x] - (int)up[x]);
+                int dn = down2 ? abs((int)down2[x] - (int)down[x]) : 0;
+                if (d < dp || d <= dn) continue;
+            }
+            if (n == cap) {
+                cap *= 2;
+                pts = g_realloc(pts, sizeof(EdgePoint) * cap);
+            }
+            pts[n++] = (EdgePoint){ x, y };
+        }
+    }
+    *count = n;
+    return pts;
+}
+
+// Highest rho bin for the angle whose cos/sin are c and s. acc is cleared here.
+static int theta_peak(const EdgePoint *pts, int n, double c, double s,
+                      int *acc, int max_rho)
+{
+    int num_rhos = 2 * max_rho;
+    memset(acc, 0, sizeof(int) * num_rhos);
+    for (int i = 0; i < n; i++) {
+        int r = (int)(pts[i].x * c + pts[i].y * s) + max_rho;
+        if (r >= 0 && r < num_rhos) acc[r]++;
+    }
+    int best = 0;
+    for (int r = 0; r < num_rhos; r++)
+        if (acc[r] > best) best = acc[r];
+    return best;
+}
+
+// Angular distance between two line directions, modulo 90 degrees:
+// the rows and the columns of a page give the same correction.
+static double fold_dist(double a, double b)
+{
+    double d = fmod(fabs(a - b), 90.0);
+    return d > 45.0 ? 90.0 - d : d;
+}
+
+SkewResult skew_hough(const GrayImage *gray, gboolean thin_edges)
+{
+    SkewResult res = { 0.0, 0.0 };
+    if (!gray || gray->w < 4 || gray->h < 4) return res;
+
+    int n = 0;
+    EdgePoint *pts = collect_edges(gray, thin_edges, &n);
+    if (n == 0) {
+        g_free(pts);
+        return res;
+    }
+
+    int max_rho = (int)sqrt((double)gray->w * gray->w + (double)gray->h * gray->h);
+    int *acc = g_malloc(sizeof(int) * 2 * max_rho);
+
+    // Trig tables, one entry per tested angle.
+    double cos_t[COARSE_STEPS], sin_t[COARSE_STEPS];
+    for (int t = 0; t < COARSE_STEPS; t++) {
+        double theta = (-90.0 + t) * M_PI / 180.0;
+        cos_t[t] = cos(theta);
+        sin_t[t] = sin(theta);
+    }
+
+    int peaks[COARSE_STEPS];
+    int best_t = 0;
+    for (int t = 0; t < COARSE_STEPS; t++) {
+        peaks[t] = theta_peak(pts, n, cos_t[t], sin_t[t], acc, max_rho);
+        if (peaks[t] > peaks[best_t]) best_t = t;
+    }
+    double coarse = -90.0 + best_t;
+
+    // Confidence: how far the winner stands above the best direction that is
+    // not the same one (nor its perpendicular).
+    int second = 0;
+    for (int t = 0; t < COARSE_STEPS; t++)
+        if (fold_dist(-90.0 + t, coarse) >= 3.0 && peaks[t] > second) second = peaks[t];
+    if (peaks[best_t] > 0) res.confidence = 1.0 - (double)second / (double)peaks[best_t];
+
+    double best_theta = coarse;
+    int best_votes = -1;
+    for (int k = 0; k < FINE_STEPS; k++) {
+        double deg = coarse - 1.0 + 0.1 * k;
+        double theta = deg * M_PI / 180.0;
+        int v = theta_peak(pts, n, cos(theta), sin(theta), acc, max_rho);
+        if (v > best_votes) {
+            best_votes = v;
+            best_theta = deg;
+        }
+    }
+
+    if (fabs(best_theta - 90) < 45) res.angle = 90 - best_theta;
+    else if (fabs(best_theta + 90) < 45) res.angle = -90 - best_theta;
+    else res.angle = -best_theta;
+
+    g_free(acc);
+    g_free(pts);
+    return res;
+}
+
+// Ink pixels of every row, every other column, relative to the page center.
+// Skipping rows too would leave every other histogram bin empty at 0 degree
+// and double its energy.
+static EdgePoint *collect_ink(const GrayImage *g, int *count)
+{
+    int cap = 1024, n = 0;
+    EdgePoint *pts = g_malloc(sizeof(EdgePoint) * cap);
+    int cx = g->w / 2, cy = g->h / 2;
+    for (int y = 0; y < g->h; y++) {
+        const guint8 *row = gray_row(g, y);
+        for (int x = 0; x < g->w; x += 2) {
+            if (row[x] >= PROFILE_INK_THR) continue;
+            if (n == cap) {
+                cap *= 2;
+                pts = g_realloc(pts, sizeof(EdgePoint) * cap);
+            }
+            pts[n++] = (EdgePoint){ x - cx, y - cy };
+        }
+    }
+    *count = n;
+    return pts;
+}
+
+// Sum of squared row counts once the points are rotated by deg.
+static double profile_energy(const EdgePoint *pts, int n, double deg,
+                             int *hist, int half)
+{
+    double a = deg * M_PI / 180.0;
+    gint64 c = (gint64)lrint(cos(a) * (1 << PROFILE_SHIFT));
+    gint64 s = (gint64)lrint(sin(a) * (1 << PROFILE_SHIFT));
+    gint64 round = (gint64)half << PROFILE_SHIFT;
+
+    memset(hist, 0, sizeof(int) * (2 * half + 1));
+    for (int i = 0; i < n; i++) {
+        // +half before the shift keeps the index non-negative
+        int r = (int)((pts[i].y * c - pts[i].x * s + round) >> PROFILE_SHIFT);
+        hist[r]++;
+    }
+    double e = 0.0;
+    for (int r = 0; r <= 2 * half; r++) e += (double)hist[r] * hist[r];
+    return e;
+}
+
+SkewResult skew_profile(const GrayImage *gray)
+{
+    SkewResult res = { 0.0, 0.0 };
+    if (!gray || gray->w < 4 || gray->h < 4) return res;
+
+    int n = 0;
+    EdgePoint *pts = collect_ink(gray, &n);
+    if (n == 0) {
+        g_free(pts);
+        return res;
+    }
+
+    int half = (int)sqrt((double)gray->w * gray->w + (double)gray->h * gray->h) / 2 + 2;
+    int *hist = g_malloc(sizeof(int) * (2 * half + 1));
+
+    double best = -1.0, sum = 0.0;
+    int best_deg = 0;
+    for (int d = -PROFILE_RANGE; d <= PROFILE_RANGE; d++) {
+        double e = profile_energy(pts, n, d, hist, half);
+        sum += e;
+        if (e > best) {
+            best = e;
+            best_deg = d;
+        }
+    }
+    if (best > 0.0) res.confidence = 1.0 - sum / (2 * PROFILE_RANGE + 1) / best;
+
+    double best_fine = -1.0, angle = best_deg;
+    for (int k = 0; k < FINE_STEPS; k++) {
+        double deg = best_deg - 1.0 + 0.1 * k;
+        double e = profile_energy(pts, n, deg, hist, half);
+        if (e > best_fine) {
+            best_fine = e;
+            angle = deg;
+        }
+    }
+    res.angle = -angle;
+
+    g_free(hist);
+    g_free(pts);
+    return res;
+}
+
+SkewResult skew_estimate(const GrayImage *gray, SkewMethod method, gboolean thin_edges)
+{
+    TRACE_SCOPE("skew_estimate");
+    if (gray) trace_count(TRACE_PIXELS, (gint64)gray->w * gray->h);
+    if (method == SKEW_PROFILE) return skew_profile(gray);
+    return skew_hough(gray, thin_edges);
+}
+
+gboolean skew_method_from_string(const char *s, SkewMethod *out)
+{
+    if (!s) return FALSE;
+    if (strcmp(s, "hough") == 0) *out = SKEW_HOUGH;
+    else if (strcmp(s, "profile") == 0) *out = SKEW_PROFILE;
+    else return FALSE;
+    return TRUE;
+}
+
+const char *skew_method_name(SkewMethod method)
+{
+    return method == SKEW_PROFILE ? "profile" : "hough";
+}
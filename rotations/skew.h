@@ -0,0 +1,37 @@
+#ifndef SKEW_H
+#define SKEW_H
+
+#include <glib.h>
+#include "grayimage.h"
+
+typedef struct
+{
+    double angle;        // correction to apply, in degrees, within [-45, 45]
+    double confidence;   // 0 = no clear line direction, 1 = single dominant one
+} SkewResult;
+
+typedef enum
+{
+    SKEW_HOUGH,
+    SKEW_PROFILE
+} SkewMethod;
+
+// Hough transform on the horizontal edges of the page: 1 degree pass over
+// [-90, 90), then 0.1 degree pass around the peak. With thin_edges only the
+// local maxima of the vertical gradient vote, which keeps one pixel per
+// stroke border instead of two or three.
+SkewResult skew_hough(const GrayImage *gray, gboolean thin_edges);
+
+// Projection profile: rotates the coordinates of the ink pixels over
+// [-45, 45] (1 degree, then 0.1 degree around the best) and keeps the angle
+// whose row histogram has the largest energy, i.e. the sharpest text lines.
+// Confidence is 1 - mean / best energy over the coarse angles.
+SkewResult skew_profile(const GrayImage *gray);
+
+SkewResult skew_estimate(const GrayImage *gray, SkewMethod method, gboolean thin_edges);
+
+// "hough" or "profile". Returns FALSE for anything else.
+gboolean skew_method_from_string(const char *s, SkewMethod *out);
+const char *skew_method_name(SkewMethod method);
+
+#endif
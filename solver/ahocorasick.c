@@ -0,0 +1,300 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ahocorasick.h"
+
+static const int DIRS[8][2] = {
+    {0, 1}, {0, -1}, {1, 0}, {-1, 0},
+    {1, 1}, {1, -1}, {-1, 1}, {-1, -1}
+};
+
+static int symbol(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c - 'A' : AC_SYMBOLS - 1;
+}
+
+int ac_build(AcAutomaton *ac, const char *const *words, int nb_words)
+{
+    memset(ac, 0, sizeof(*ac));
+    int max_nodes = 1;
+    for (int w = 0; w < nb_words; w++) max_nodes += (int)strlen(words[w]);
+
+    ac->nb_words = nb_words;
+    ac->text = malloc(sizeof(char *) * (size_t)(nb_words > 0 ? nb_words : 1));
+    ac->len = malloc(sizeof(int) * (size_t)(nb_words > 0 ? nb_words : 1));
+    ac->same_next = malloc(sizeof(int) * (size_t)(nb_words > 0 ? nb_words : 1));
+    ac->exact = malloc((size_t)(nb_words > 0 ? nb_words : 1));
+    ac->delta = malloc(sizeof(int) * AC_SYMBOLS * (size_t)max_nodes);
+    ac->word_at = malloc(sizeof(int) * (size_t)max_nodes);
+    ac->dict = malloc(sizeof(int) * (size_t)max_nodes);
+    int *fail = malloc(sizeof(int) * (size_t)max_nodes);
+    int *queue = malloc(sizeof(int) * (size_t)max_nodes);
+    if (!ac->text || !ac->len || !ac->same_next || !ac->exact || !ac->delta
+        || !ac->word_at || !ac->dict || !fail || !queue) {
+        free(fail);
+        free(queue);
+        ac_free(ac);
+        return 0;
+    }
+
+    // Trie
+    ac->nb_nodes = 1;
+    memset(ac->delta, -1, sizeof(int) * AC_SYMBOLS);
+    ac->word_at[0] = -1;
+    for (int w = 0; w < nb_words; w++) {
+        const char *s = words[w];
+        ac->text[w] = s;
+        ac->len[w] = (int)strlen(s);
+        ac->same_next[w] = -1;
+        ac->exact[w] = 1;
+        if (ac->len[w] == 0) continue;   // never found, like ChercheMot
+
+        int node = 0;
+        for (int k = 0; s[k]; k++) {
+            int c = symbol(s[k]);
+            if (c == AC_SYMBOLS - 1) ac->exact[w] = 0;
+            int *next = &ac->delta[node * AC_SYMBOLS + c];
+            if (*next < 0) {
+                int n = ac->nb_nodes++;
+                memset(&ac->delta[n * AC_SYMBOLS], -1, sizeof(int) * AC_SYMBOLS);
+                ac->word_at[n] = -1;
+                *next = n;
+            }
+            node = *next;
+        }
+        if (ac->word_at[node] < 0) {
+            ac->word_at[node] = w;
+        } else {
+            int t = ac->word_at[node];
+            while (ac->same_next[t] >= 0) t = ac->same_next[t];
+            ac->same_next[t] = w;
+        }
+    }
+
+    // Failure links, folded into a full transition table (BFS order).
+    int head = 0, tail = 0;
+    ac->dict[0] = -1;
+    for (int c = 0; c < AC_SYMBOLS; c++) {
+        int v = ac->delta[c];
+        if (v < 0) {
+            ac->delta[c] = 0;
+        } else {
+            fail[v] = 0;
+            ac->dict[v] = -1;
+            queue[tail++] = v;
+        }
+    }
+    while (head < tail) {
+        int u = queue[head++];
+        for (int c = 0; c < AC_SYMBOLS; c++) {
+            int v = ac->delta[u * AC_SYMBOLS + c];
+            int f = ac->delta[fail[u] * AC_SYMBOLS + c];
+            if (v < 0) {
+                ac->delta[u * AC_SYMBOLS + c] = f;
+                continue;
+            }
+            fail[v] = f;
+            ac->dict[v] = ac->word_at[f] >= 0 ? f : ac->dict[f];
+            queue[tail++] = v;
+        }
+    }
+
+    free(fail);
+    free(queue);
+    return 1;
+}
+
+void ac_free(AcAutomaton *ac)
+{
+    free(ac->delta);
+    free(ac->word_at);
+    free(ac->dict);
+    free(ac->len);
+    free(ac->same_next);
+    free(ac->text);
+    free(ac->exact);
+    memset(ac, 0, sizeof(*ac));
+}
+
+typedef void (*AcMatchFn)(const AcMatch *m, void *ctx);
+
+// Words with characters outside A..Z share one symbol, so their matches are
+// checked against the grid.
+static int same_text(const AcAutomaton *ac, const Grid *grille,
+                     const AcMatch *m)
+{
+    const char *s = ac->text[m->word];
+    int x = m->ligneDebut, y = m->colDebut;
+    for (int k = 0; k < ac->len[m->word]; k++) {
+        if (grid_at(grille, x, y) != s[k]) return 0;
+        x += DIRS[m->dir][0];
+        y += DIRS[m->dir][1];
+    }
+    return 1;
+}
+
+static void sweep(const AcAutomaton *ac, const Grid *grille, AcMatchFn fn, void *ctx)
+{
+    int nbLignes = grille->height, nbColonnes = grille->width;
+    for (int d = 0; d < 8; d++) {
+        int di = DIRS[d][0], dj = DIRS[d][1];
+        for (int i = 0; i < nbLignes; i++) {
+            for (int j = 0; j < nbColonnes; j++) {
+                // one pass per line, from the cell whose predecessor is off the grid
+                int pi = i - di, pj = j - dj;
+                if (pi >= 0 && pi < nbLignes && pj >= 0 && pj < nbColonnes) continue;
+
+                int state = 0;
+                for (int x = i, y = j; x >= 0 && x < nbLignes && y >= 0 && y < nbColonnes;
+                     x += di, y += dj) {
+                    state = ac->delta[state * AC_SYMBOLS + symbol(grid_at(grille, x, y))];
+                    int node = ac->word_at[state] >= 0 ? state : ac->dict[state];
+                    for (; node >= 0; node = ac->dict[node]) {
+                        for (int w = ac->word_at[node]; w >= 0; w = ac->same_next[w]) {
+                            int back = ac->len[w] - 1;
+                            // a single letter has no direction: report it once
+                            if (back == 0 && d != 0) continue;
+                            AcMatch m = { w, x - back * di, y - back * dj, x, y, d };
+                            if (!ac->exact[w] && !same_text(ac, grille, &m)) continue;
+                            fn(&m, ctx);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+typedef struct
+{
+    AcMatch *items;
+    int len, cap;
+    int failed;
+} MatchList;
+
+static void collect_match(const AcMatch *m, void *ctx)
+{
+    MatchList *l = ctx;
+    if (l->failed) return;
+    if (l->len == l->cap) {
+        int cap = l->cap ? l->cap * 2 : 64;
+        AcMatch *items = realloc(l->items, sizeof(AcMatch) * (size_t)cap);
+        if (!items) {
+            l->failed = 1;
+            return;
+        }
+        l->items = items;
+        l->cap = cap;
+    }
+    l->items[l->len++] = *m;
+}
+
+typedef struct
+{
+    long long key;   // word, then ChercheMot's order within the word
+    int idx;
+} MatchKey;
+
+static int cmp_match_key(const void *a, const void *b)
+{
+    long long ka = ((const MatchKey *)a)->key, kb = ((const MatchKey *)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+
+static void mark_covered(const Grid *grille, const AcMatch *m, int len,
+                         unsigned char *covered)
+{
+    int x = m->ligneDebut, y = m->colDebut;
+    for (int k = 0; k < len; k++) {
+        covered[(size_t)x * (size_t)grille->width + (size_t)y] = 1;
+        x += DIRS[m->dir][0];
+        y += DIRS[m->dir][1];
+    }
+}
+
+int ac_find_all(const AcAutomaton *ac, const Grid *grille, AcMatchList *out,
+                unsigned char *covered)
+{
+    memset(out, 0, sizeof(*out));
+    MatchList l = { NULL, 0, 0, 0 };
+    sweep(ac, grille, collect_match, &l);
+
+    out->nb_words = ac->nb_words;
+    out->start = calloc((size_t)ac->nb_words + 1, sizeof(int));
+    out->items = malloc(sizeof(AcMatch) * (size_t)(l.len > 0 ? l.len : 1));
+    MatchKey *keys = malloc(sizeof(MatchKey) * (size_t)(l.len > 0 ? l.len : 1));
+    if (l.failed || !out->start || !out->items || !keys) {
+        free(keys);
+        free(l.items);
+        ac_match_list_free(out);
+        return -1;
+    }
+
+    long long cells = (long long)grille->width * grille->height;
+    for (int i = 0; i < l.len; i++) {
+        const AcMatch *m = &l.items[i];
+        long long cell = (long long)m->ligneDebut * grille->width + m->colDebut;
+        keys[i].key = ((long long)m->word * cells + cell) * 8 + m->dir;
+        keys[i].idx = i;
+        out->start[m->word + 1]++;
+    }
+    qsort(keys, (size_t)l.len, sizeof(MatchKey), cmp_match_key);
+    for (int i = 0; i < l.len; i++) out->items[i] = l.items[keys[i].idx];
+    for (int w = 0; w < ac->nb_words; w++) out->start[w + 1] += out->start[w];
+
+    if (covered) {
+        memset(covered, 0, (size_t)cells);
+        for (int i = 0; i < l.len; i++)
+            mark_covered(grille, &l.items[i], ac->len[l.items[i].word], covered);
+    }
+
+    free(keys);
+    free(l.items);
+    return l.len;
+}
+
+void ac_match_list_free(AcMatchList *l)
+{
+    free(l->items);
+    free(l->start);
+    memset(l, 0, sizeof(*l));
+}
+
+int ac_leftover_letters(const Grid *grille, const unsigned char *covered, char *out)
+{
+    size_t cells = (size_t)grille->width * (size_t)grille->height;
+    int n = 0;
+    for (size_t c = 0; c < cells; c++) {
+        char letter = grille->cells[c];
+        if (!covered[c] && letter != '\0') out[n++] = letter;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+typedef struct
+{
+    AcMatch *first;
+    int *found;
+    int cols;
+} FirstMatch;
+
+static void keep_first(const AcMatch *m, void *ctx)
+{
+    FirstMatch *f = ctx;
+    AcMatch *cur = &f->first[m->word];
+    // ChercheMot's order: start cell in raster order, then direction
+    long key = ((long)m->ligneDebut * f->cols + m->colDebut) * 8 + m->dir;
+    long cur_key = ((long)cur->ligneDebut * f->cols + cur->colDebut) * 8 + cur->dir;
+    if (!f->found[m->word] || key < cur_key) {
+        *cur = *m;
+        f->found[m->word] = 1;
+    }
+}
+
+void ac_find_first(const AcAutomaton *ac, const Grid *grille,
+                   AcMatch *first, int *found)
+{
+    memset(found, 0, sizeof(int) * (size_t)ac->nb_words);
+    FirstMatch f = { first, found, grille->width };
+    sweep(ac, grille, keep_first, &f);
+}
@@ -0,0 +1,63 @@
+#ifndef AHOCORASICK_H
+#define AHOCORASICK_H
+
+#include "solver.h"
+
+#define AC_SYMBOLS 27   // A..Z, then everything else
+
+// Aho-Corasick automaton over a word list: one sweep of every grid line in
+// each of ChercheMot's 8 directions finds all the words at once, whatever
+// their number.
+typedef struct
+{
+    int nb_nodes;
+    int *delta;          // nb_nodes * AC_SYMBOLS transitions (full automaton)
+    int *word_at;        // node -> first word ending there, -1 if none
+    int *dict;           // node -> nearest suffix node with a word, -1 if none
+    int nb_words;
+    int *len;            // word -> length
+    int *same_next;      // word -> next word with the same text, -1 at the end
+    const char **text;   // word -> text (not copied)
+    unsigned char *exact;// word -> 1 if it only has A..Z (no check on match)
+} AcAutomaton;
+
+typedef struct
+{
+    int word;
+    int ligneDebut, colDebut;
+    int ligneFin, colFin;
+    int dir;             // index in ChercheMot's direction table
+} AcMatch;
+
+// words must stay alive as long as the automaton. Returns 0 on allocation failure.
+int ac_build(AcAutomaton *ac, const char *const *words, int nb_words);
+void ac_free(AcAutomaton *ac);
+
+// Every occurrence of every word, grouped by word: word w owns
+// items[start[w]] .. items[start[w + 1] - 1], in ChercheMot's order, so the
+// first one is what ChercheMot returns. Palindromes are reported in both
+// directions, single letters once per cell.
+typedef struct
+{
+    AcMatch *items;
+    int *start;          // nb_words + 1 entries
+    int nb_words;
+} AcMatchList;
+
+// Fills *out in one sweep and returns the number of matches (-1 on
+// allocation failure). If covered is not NULL (width * height bytes, row
+// major), it is set to 1 for the cells of at least one match, 0 elsewhere.
+int ac_find_all(const AcAutomaton *ac, const Grid *grille, AcMatchList *out,
+                unsigned char *covered);
+void ac_match_list_free(AcMatchList *l);
+
+// Letters of the cells not covered by any word, in raster order: the hidden
+// message of the puzzle. out needs width * height + 1 bytes. Returns its length.
+int ac_leftover_letters(const Grid *grille, const unsigned char *covered, char *out);
+
+// Per word, the match ChercheMot returns (first start cell in raster
+// order, then first direction): found[w] is 0 or 1, first[w] the match.
+void ac_find_first(const AcAutomaton *ac, const Grid *grille,
+                   AcMatch *first, int *found);
+
+#endif
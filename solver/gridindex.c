@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <string.h>
+#include "gridindex.h"
+
+// Same directions, in the same order, as ChercheMot.
+static const int DIRS[8][2] = {
+    {0, 1}, {0, -1}, {1, 0}, {-1, 0},
+    {1, 1}, {1, -1}, {-1, 1}, {-1, -1}
+};
+
+#define NB_KEYS 27   // A..Z, then everything else
+
+static int letter_key(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c - 'A' : NB_KEYS - 1;
+}
+
+static int inside(const GridIndex *ix, int i, int j)
+{
+    return i >= 0 && i < ix->rows && j >= 0 && j < ix->cols;
+}
+
+static void build_lines(GridIndex *ix, const Grid *grille, int d)
+{
+    int di = DIRS[d][0], dj = DIRS[d][1];
+    int pos = 0;
+    for (int i = 0; i < ix->rows; i++) {
+        for (int j = 0; j < ix->cols; j++) {
+            // a line starts where the previous cell is off the grid
+            if (inside(ix, i - di, j - dj)) continue;
+            int len = 0;
+            while (inside(ix, i + len * di, j + len * dj)) len++;
+            for (int k = 0; k < len; k++) {
+                int x = i + k * di, y = j + k * dj;
+                int cell = x * ix->cols + y;
+                ix->lines[d][pos + k] = grid_at(grille, x, y);
+                ix->off[d][cell] = pos + k;
+                ix->rem[d][cell] = len - k;
+            }
+            pos += len;
+        }
+    }
+}
+
+int grid_index_build(GridIndex *ix, const Grid *grille)
+{
+    int nbLignes = grille->height, nbColonnes = grille->width;
+    memset(ix, 0, sizeof(*ix));
+    if (nbLignes <= 0 || nbColonnes <= 0) return 0;
+    ix->rows = nbLignes;
+    ix->cols = nbColonnes;
+    int n = nbLignes * nbColonnes;
+
+    for (int d = 0; d < 8; d++) {
+        ix->lines[d] = malloc((size_t)n);
+        ix->off[d] = malloc(sizeof(int) * (size_t)n);
+        ix->rem[d] = malloc(sizeof(int) * (size_t)n);
+        if (!ix->lines[d] || !ix->off[d] || !ix->rem[d]) {
+            grid_index_free(ix);
+            return 0;
+        }
+        build_lines(ix, grille, d);
+    }
+
+    // Counting sort of the starts by key, keeping the raster/direction order.
+    ix->pair_start = calloc(NB_KEYS * NB_KEYS + 1, sizeof(int));
+    ix->letter_start = calloc(NB_KEYS + 1, sizeof(int));
+    ix->pair_starts = malloc(sizeof(int) * 8 * (size_t)n);
+    ix->letter_cells = malloc(sizeof(int) * (size_t)n);
+    int *cursor = malloc(sizeof(int) * NB_KEYS * NB_KEYS);
+    if (!ix->pair_start || !ix->letter_start || !ix->pair_starts
+        || !ix->letter_cells || !cursor) {
+        free(cursor);
+        grid_index_free(ix);
+        return 0;
+    }
+
+    for (int cell = 0; cell < n; cell++) {
+        const char *c = ix->lines[0] + ix->off[0][cell];
+        ix->letter_start[letter_key(c[0]) + 1]++;
+        for (int d = 0; d < 8; d++) {
+            if (ix->rem[d][cell] < 2) continue;
+            const char *s = ix->lines[d] + ix->off[d][cell];
+            ix->pair_start[letter_key(s[0]) * NB_KEYS + letter_key(s[1]) + 1]++;
+        }
+    }
+    for (int k = 0; k < NB_KEYS * NB_KEYS; k++) ix->pair_start[k + 1] += ix->pair_start[k];
+    for (int k = 0; k < NB_KEYS; k++) ix->letter_start[k + 1] += ix->letter_start[k];
+
+    memcpy(cursor, ix->pair_start, sizeof(int) * NB_KEYS * NB_KEYS);
+    for (int cell = 0; cell < n; cell++) {
+        for (int d = 0; d < 8; d++) {
+            if (ix->rem[d][cell] < 2) continue;
+            const char *s = ix->lines[d] + ix->off[d][cell];
+            ix->pair_starts[cursor[letter_key(s[0]) * NB_KEYS + letter_key(s[1])]++] = cell * 8 + d;
+        }
+    }
+    memcpy(cursor, ix->letter_start, sizeof(int) * NB_KEYS);
+    for (int cell = 0; cell < n; cell++) {
+        int k = letter_key(ix->lines[0][ix->off[0][cell]]);
+        ix->letter_cells[cursor[k]++] = cell;
+    }
+    free(cursor);
+    return 1;
+}
+
+void grid_index_free(GridIndex *ix)
+{
+    for (int d = 0; d < 8; d++) {
+        free(ix->lines[d]);
+        free(ix->off[d]);
+        free(ix->rem[d]);
+    }
+    free(ix->pair_start);
+    free(ix->pair_starts);
+    free(ix->letter_start);
+    free(ix->letter_cells);
+    memset(ix, 0, sizeof(*ix));
+}
+
+int grid_index_find(const GridIndex *ix, const char *mot,
+                    int *ligneDebut, int *colDebut,
+                    int *ligneFin, int *colFin)
+{
+    int len = (int)strlen(mot);
+    if (len == 0 || ix->rows == 0) return 0;
+
+    if (len == 1) {
+        int k = letter_key(mot[0]);
+        for (int e = ix->letter_start[k]; e < ix->letter_start[k + 1]; e++) {
+            int cell = ix->letter_cells[e];
+            if (ix->lines[0][ix->off[0][cell]] != mot[0]) continue;
+            *ligneDebut = *ligneFin = cell / ix->cols;
+            *colDebut = *colFin = cell % ix->cols;
+            return 1;
+        }
+        return 0;
+    }
+
+    int k = letter_key(mot[0]) * NB_KEYS + letter_key(mot[1]);
+    for (int e = ix->pair_start[k]; e < ix->pair_start[k + 1]; e++) {
+        int cell = ix->pair_starts[e] >> 3, d = ix->pair_starts[e] & 7;
+        if (ix->rem[d][cell] < len) continue;
+        if (memcmp(ix->lines[d] + ix->off[d][cell], mot, (size_t)len) != 0) continue;
+
+        int i = cell / ix->cols, j = cell % ix->cols;
+        *ligneDebut = i;
+        *colDebut = j;
+        *ligneFin = i + (len - 1) * DIRS[d][0];
+        *colFin = j + (len - 1) * DIRS[d][1];
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef GRIDINDEX_H
+#define GRIDINDEX_H
+
+#include "solver.h"
+
+// Precomputed view of a grid for solving many words: for each of the 8
+// directions of ChercheMot, the grid lines read in that direction, and the
+// start cells grouped by their first two letters. A lookup compares the
+// candidate lines with memcmp instead of walking the grid letter by letter,
+// and returns the same match as ChercheMot.
+typedef struct
+{
+    int rows, cols;
+    char *lines[8];        // lines of direction d, read in direction d, end to end
+    int *off[8];           // cell -> offset of the cell in lines[d]
+    int *rem[8];           // cell -> letters from the cell to the border, itself included
+    int *pair_start;       // (first, second letter) -> range in pair_starts
+    int *pair_starts;      // cell * 8 + d, in ChercheMot's order
+    int *letter_start;     // first letter -> range in letter_cells (1-letter words)
+    int *letter_cells;
+} GridIndex;
+
+int grid_index_build(GridIndex *ix, const Grid *grille);
+void grid_index_free(GridIndex *ix);
+
+int grid_index_find(const GridIndex *ix, const char *mot,
+                    int *ligneDebut, int *colDebut,
+                    int *ligneFin, int *colFin);
+
+#endif
@@ -1,35 +1,128 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "solver.h" // Always include the corresponding header
+#include "ahocorasick.h"
 
-// MAX_MAT is defined in solver.h
+int grid_alloc(Grid *grille, int width, int height)
+{
+    grille->width = width;
+    grille->height = height;
+    grille->cells = calloc((size_t)width * (size_t)height, 1);
+    if (grille->cells == NULL && width > 0 && height > 0)
+    {
+        grille->width = grille->height = 0;
+        return 0;
+    }
+    return 1;
+}
+
+void grid_free(Grid *grille)
+{
+    free(grille->cells);
+    grille->cells = NULL;
+    grille->width = grille->height = 0;
+}
 
-int CreaMatrice(const char *Fichier , char matrice[MAX_MAT][MAX_MAT])
+// Ligne suivante du fichier, sans limite de longueur. *buf grandit au besoin.
+static int LireLigne(FILE *f, char **buf, size_t *cap)
 {
+    size_t len = 0;
+    for (;;)
+    {
+        if (*cap - len < 2)
+        {
+            size_t ncap = *cap ? *cap * 2 : 256;
+            char *nbuf = realloc(*buf, ncap);
+            if (nbuf == NULL) return -1;
+            *buf = nbuf;
+            *cap = ncap;
+        }
+        if (!fgets(*buf + len, (int)(*cap - len), f)) break;
+        len += strlen(*buf + len);
+        if (len > 0 && (*buf)[len - 1] == '\n') break;
+    }
+    if (len == 0) return 0;
+    (*buf)[strcspn(*buf, "\r\n")] = '\0';
+    return 1;
+}
+
+// Ajoute une ligne non vide à la grille (la première fixe la largeur).
+static int AjouteLigne(Grid *grille, int *capLignes, const char *ligne, size_t len)
+{
+    if (grille->height == 0) grille->width = (int)len;
+    if (grille->height == *capLignes)
+    {
+        *capLignes = *capLignes ? *capLignes * 2 : 64;
+        char *cells = realloc(grille->cells, (size_t)*capLignes * (size_t)grille->width);
+        if (cells == NULL) return 0;
+        grille->cells = cells;
+    }
+    char *dst = grid_row(grille, grille->height);
+    size_t n = len < (size_t)grille->width ? len : (size_t)grille->width;
+    memcpy(dst, ligne, n);
+    memset(dst + n, '\0', (size_t)grille->width - n);
+    grille->height++;
+    return 1;
+}
+
+int CreaMatrice(const char *Fichier, Grid *grille)
+{
+    grille->width = grille->height = 0;
+    grille->cells = NULL;
+
     FILE *f = fopen(Fichier, "r");
     if(f == NULL)
     {
         printf("Error: Cannot open file %s\n", Fichier);
         return 0;
     } 
-    int ligne = 0;
-    char ligneM[MAX_MAT];
 
-    while (fgets(ligneM, sizeof(ligneM), f) && ligne < MAX_MAT)
+    char *ligneM = NULL;
+    size_t cap = 0;
+    int capLignes = 0, r;
+    while ((r = LireLigne(f, &ligneM, &cap)) > 0)
     {
-        ligneM[strcspn(ligneM,"\n")] = '\0'; 
-        if(strlen(ligneM)==0) continue;
-        strcpy(matrice[ligne], ligneM); 
-        ligne++;
+        size_t len = strlen(ligneM);
+        if(len==0) continue;
+        if (!AjouteLigne(grille, &capLignes, ligneM, len)) { r = -1; break; }
     }
-    
+
+    free(ligneM);
     fclose(f);
-    return ligne;
+    if (r < 0)
+    {
+        printf("Error: Out of memory reading %s\n", Fichier);
+        grid_free(grille);
+        return 0;
+    }
+    return grille->height;
 }
 
-int ChercheMot(const char *mot, char matrice[MAX_MAT][MAX_MAT], int nbLignes, int nbColonnes,
+int CreaMatriceTexte(const char *texte, Grid *grille)
+{
+    grille->width = grille->height = 0;
+    grille->cells = NULL;
+
+    int capLignes = 0;
+    while (*texte)
+    {
+        size_t len = strcspn(texte, "\r\n");
+        if (len > 0 && !AjouteLigne(grille, &capLignes, texte, len))
+        {
+            grid_free(grille);
+            return 0;
+        }
+        texte += len;
+        texte += strspn(texte, "\r\n");
+    }
+    return grille->height;
+}
+
+int ChercheMot(const char *mot, const Grid *grille,
                int *ligneDebut, int *colDebut, int *ligneFin, int *colFin)
 {
+    int nbLignes = grille->height, nbColonnes = grille->width;
     int len = strlen(mot);
     // 8 directions
     int directions[8][2] = {
@@ -38,8 +131,9 @@ int ChercheMot(const char *mot, char matrice[MAX_MAT][MAX_MAT], int nbLignes, in
     };
 
     for (int i = 0; i < nbLignes; i++) {
+        const char *ligne = grid_row(grille, i);
         for (int j = 0; j < nbColonnes; j++) {
-            if (matrice[i][j] != mot[0]) continue;
+            if (ligne[j] != mot[0]) continue;
 
             for (int d = 0; d < 8; d++) {
                 int k, x = i, y = j;
@@ -48,7 +142,7 @@ int ChercheMot(const char *mot, char matrice[MAX_MAT][MAX_MAT], int nbLignes, in
                     y += directions[d][1];
 
                     if (x < 0 || x >= nbLignes || y < 0 || y >= nbColonnes) break;
-                    if (matrice[x][y] != mot[k]) break;
+                    if (grid_at(grille, x, y) != mot[k]) break;
                 }
                 if (k == len) {
                     *ligneDebut = i; *colDebut = j;
@@ -70,34 +164,121 @@ void ConvertirMajuscules(char *mot)
     }
 }
 
+// Toutes les occurrences de chaque mot du fichier, puis les lettres
+// restantes (message caché).
+static void solver_all(const char *fichierGrille, const char *fichierMots)
+{
+    Grid grille;
+    if (CreaMatrice(fichierGrille, &grille) == 0) return;
+
+    FILE *f = fopen(fichierMots, "r");
+    if (f == NULL)
+    {
+        printf("Error: Cannot open file %s\n", fichierMots);
+        grid_free(&grille);
+        return;
+    }
+    char **mots = NULL;
+    int nbMots = 0, capMots = 0;
+    char *ligne = NULL;
+    size_t cap = 0;
+    while (LireLigne(f, &ligne, &cap) > 0)
+    {
+        if (ligne[0] == '\0') continue;
+        ConvertirMajuscules(ligne);
+        if (nbMots == capMots)
+        {
+            capMots = capMots ? capMots * 2 : 64;
+            char **m = realloc(mots, sizeof(char *) * (size_t)capMots);
+            if (m == NULL) break;
+            mots = m;
+        }
+        size_t taille = strlen(ligne) + 1;
+        if ((mots[nbMots] = malloc(taille)) == NULL) break;
+        memcpy(mots[nbMots++], ligne, taille);
+    }
+    free(ligne);
+    fclose(f);
+
+    AcAutomaton ac;
+    AcMatchList all;
+    size_t cells = (size_t)grille.width * (size_t)grille.height;
+    unsigned char *covered = malloc(cells);
+    char *reste = malloc(cells + 1);
+    if (covered && reste && ac_build(&ac, (const char *const *)mots, nbMots))
+    {
+        if (ac_find_all(&ac, &grille, &all, covered) >= 0)
+        {
+            for (int w = 0; w < nbMots; w++)
+            {
+                int n = all.start[w + 1] - all.start[w];
+                printf("%s: %d\n", mots[w], n);
+                for (int k = all.start[w]; k < all.start[w + 1]; k++)
+                {
+                    const AcMatch *m = &all.items[k];
+                    printf("  from (%d,%d) to (%d,%d)\n",
+                           m->ligneDebut, m->colDebut, m->ligneFin, m->colFin);
+                }
+            }
+            ac_leftover_letters(&grille, covered, reste);
+            printf("Leftover letters: %s\n", reste);
+            ac_match_list_free(&all);
+        }
+        else printf("Error: Out of memory\n");
+        ac_free(&ac);
+    }
+    else printf("Error: Out of memory\n");
+
+    free(reste);
+    free(covered);
+    for (int w = 0; w < nbMots; w++) free(mots[w]);
+    free(mots);
+    grid_free(&grille);
+}
+
 void solver_test(int argc, char *argv[]) 
 {
     // Le main passera (argc-1) et &argv[1].
     // Donc argv[0] sera "solver", argv[1] le fichier, argv[2] le mot.
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    {
+        solver_bench(argc - 1, &argv[1]);
+        return;
+    }
+    if (argc > 3 && strcmp(argv[1], "--all") == 0)
+    {
+        solver_all(argv[2], argv[3]);
+        return;
+    }
     if (argc < 3)
     {
         printf("Usage: ./ocr solver <grid.txt> <word>\n");
+        printf("       ./ocr solver --all <grid.txt> <words.txt>\n");
+        printf("       ./ocr solver --bench [rows cols words]\n");
         return;
     }   
 
-    char matrice[MAX_MAT][MAX_MAT];
-    int nbLignes = CreaMatrice(argv[1], matrice);
-    if (nbLignes == 0) return;
+    Grid grille;
+    if (CreaMatrice(argv[1], &grille) == 0) return;
 
-    int nbColonnes = strlen(matrice[0]); 
-    
-    char mot_a_chercher[100];
-    strncpy(mot_a_chercher, argv[2], 99);
-    mot_a_chercher[99] = '\0';
+    size_t taille = strlen(argv[2]) + 1;
+    char *mot_a_chercher = malloc(taille);
+    if (mot_a_chercher == NULL) {
+        grid_free(&grille);
+        return;
+    }
+    memcpy(mot_a_chercher, argv[2], taille);
 
     ConvertirMajuscules(mot_a_chercher);
 
     int dL, dC, fL, fC;
-    if(ChercheMot(mot_a_chercher, matrice, nbLignes, nbColonnes, &dL, &dC, &fL, &fC))
+    if(ChercheMot(mot_a_chercher, &grille, &dL, &dC, &fL, &fC))
     {
         printf("Word FOUND from (%d,%d) to (%d,%d)\n", dL, dC, fL, fC);
     }
     else {
         printf("Word NOT found.\n");
     }
+    free(mot_a_chercher);
+    grid_free(&grille);
 }
\ No newline at end of file
@@ -4,14 +4,35 @@
 #include <stdio.h>
 #include <string.h>
 
-// Renommage de MAX en MAX_MAT pour éviter les conflits avec glib/gtk
-#define MAX_MAT 100
-#define TAILLE_MAX 100
+// Grille de lettres allouée sur le tas, à la taille du fichier lu.
+typedef struct
+{
+    int width, height;   // colonnes, lignes
+    char *cells;         // height lignes de width lettres, bout à bout
+} Grid;
 
-int CreaMatrice(const char *Fichier, char matrice[MAX_MAT][MAX_MAT]);
+// Allocates a width x height grid filled with '\0'. Returns 0 on failure.
+int grid_alloc(Grid *grille, int width, int height);
+void grid_free(Grid *grille);
 
-int ChercheMot (const char *mot, char matrice[MAX_MAT][MAX_MAT],
-                int nbLignes , int nbColonnes,
+static inline char *grid_row(const Grid *grille, int ligne)
+{
+    return grille->cells + (size_t)ligne * (size_t)grille->width;
+}
+
+static inline char grid_at(const Grid *grille, int ligne, int col)
+{
+    return grille->cells[(size_t)ligne * (size_t)grille->width + (size_t)col];
+}
+
+// Reads the non-empty lines of Fichier. The width is the length of the
+// first one: longer lines are cut, shorter ones padded with '\0'.
+// Returns the number of lines, 0 on error (grille is then empty).
+int CreaMatrice(const char *Fichier, Grid *grille);
+// Same, from the contents of such a file.
+int CreaMatriceTexte(const char *texte, Grid *grille);
+
+int ChercheMot (const char *mot, const Grid *grille,
                 int *ligneDebut , int *colDebut,
                 int *ligneFin, int *colFin);
 
@@ -20,4 +41,8 @@ void ConvertirMajuscules(char *mot);
 // Correction : ajout des arguments argc/argv
 void solver_test(int argc, char *argv[]); 
 
+// ./ocr_project solver --bench [rows cols words]: random grid and words,
+// checks that the solvers agree with ChercheMot and times them.
+void solver_bench(int argc, char *argv[]);
+
 #endif
\ No newline at end of file
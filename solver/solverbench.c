@@ -0,0 +1,155 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "solver.h"
+#include "gridindex.h"
+#include "ahocorasick.h"
+
+// Same directions, in the same order, as ChercheMot.
+static const int DIRS[8][2] = {
+    {0, 1}, {0, -1}, {1, 0}, {-1, 0},
+    {1, 1}, {1, -1}, {-1, 1}, {-1, -1}
+};
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int same_result(const int r[5], const int *e)
+{
+    return r[0] == e[0] && (!r[0] || memcmp(r, e, sizeof(int) * 5) == 0);
+}
+
+void solver_bench(int argc, char *argv[])
+{
+    // argv[0] is "--bench"
+    int rows = argc > 1 ? atoi(argv[1]) : 99;
+    int cols = argc > 2 ? atoi(argv[2]) : 99;
+    int nb_words = argc > 3 ? atoi(argv[3]) : 20000;
+    if (rows < 1) rows = 99;
+    if (cols < 1) cols = 99;
+    if (nb_words < 1) nb_words = 1;
+
+    Grid grille;
+    if (!grid_alloc(&grille, cols, rows)) {
+        printf("Error: grid allocation failed\n");
+        return;
+    }
+    srand(42);
+    for (int i = 0; i < rows; i++) {
+        char *ligne = grid_row(&grille, i);
+        for (int j = 0; j < cols; j++) ligne[j] = (char)('A' + rand() % 26);
+    }
+
+    // Half of the words are read from the grid, half are random.
+    char (*words)[16] = malloc(sizeof(*words) * (size_t)nb_words);
+    const char **list = malloc(sizeof(char *) * (size_t)nb_words);
+    int *ref = malloc(sizeof(int) * 5 * (size_t)nb_words);
+    AcMatch *first = malloc(sizeof(AcMatch) * (size_t)nb_words);
+    int *hit = malloc(sizeof(int) * (size_t)nb_words);
+    if (!words || !list || !ref || !first || !hit) {
+        printf("Error: allocation failed\n");
+        goto out;
+    }
+    for (int w = 0; w < nb_words; w++) {
+        int len = 3 + rand() % 10;
+        if (w % 2 == 0) {
+            int i = rand() % rows, j = rand() % cols, d = rand() % 8;
+            int k = 0;
+            while (k < len && i >= 0 && i < rows && j >= 0 && j < cols) {
+                words[w][k++] = grid_at(&grille, i, j);
+                i += DIRS[d][0];
+                j += DIRS[d][1];
+            }
+            words[w][k] = '\0';
+        } else {
+            for (int k = 0; k < len; k++) words[w][k] = (char)('A' + rand() % 26);
+            words[w][len] = '\0';
+        }
+        list[w] = words[w];
+    }
+
+    double t0 = now_ms();
+    for (int w = 0; w < nb_words; w++) {
+        int *r = ref + 5 * w;
+        r[0] = ChercheMot(words[w], &grille, &r[1], &r[2], &r[3], &r[4]);
+    }
+    double t1 = now_ms();
+
+    GridIndex ix;
+    if (!grid_index_build(&ix, &grille)) {
+        printf("Error: index allocation failed\n");
+        goto out;
+    }
+    double t2 = now_ms();
+    int found = 0, ix_mismatches = 0;
+    for (int w = 0; w < nb_words; w++) {
+        int r[5] = {0, 0, 0, 0, 0};
+        r[0] = grid_index_find(&ix, words[w], &r[1], &r[2], &r[3], &r[4]);
+        if (!same_result(r, ref + 5 * w)) ix_mismatches++;
+        found += r[0];
+    }
+    double t3 = now_ms();
+    grid_index_free(&ix);
+
+    AcAutomaton ac;
+    if (!ac_build(&ac, list, nb_words)) {
+        printf("Error: automaton allocation failed\n");
+        goto out;
+    }
+    double t4 = now_ms();
+    ac_find_first(&ac, &grille, first, hit);
+    double t5 = now_ms();
+    int ac_mismatches = 0;
+    for (int w = 0; w < nb_words; w++) {
+        const AcMatch *m = &first[w];
+        int r[5] = { hit[w], m->ligneDebut, m->colDebut, m->ligneFin, m->colFin };
+        if (!same_result(r, ref + 5 * w)) ac_mismatches++;
+    }
+    AcMatchList all;
+    unsigned char *covered = malloc((size_t)rows * (size_t)cols);
+    int nb_all = covered ? ac_find_all(&ac, &grille, &all, covered) : -1;
+    double t6 = now_ms();
+    // the first match of each word must still be ChercheMot's
+    int all_mismatches = 0, repeated = 0, nb_covered = 0;
+    if (nb_all >= 0) {
+        for (int w = 0; w < nb_words; w++) {
+            int n = all.start[w + 1] - all.start[w];
+            const AcMatch *m = &all.items[all.start[w]];
+            int r[5] = { n > 0, 0, 0, 0, 0 };
+            if (n > 0) {
+                r[1] = m->ligneDebut; r[2] = m->colDebut;
+                r[3] = m->ligneFin; r[4] = m->colFin;
+            }
+            if (!same_result(r, ref + 5 * w)) all_mismatches++;
+            repeated += n > 1;
+        }
+        for (long c = 0; c < (long)rows * cols; c++) nb_covered += covered[c];
+        ac_match_list_free(&all);
+    }
+    free(covered);
+    ac_free(&ac);
+
+    printf("Grid %dx%d, %d words (%d found)\n", rows, cols, nb_words, found);
+    printf("ChercheMot   : %9.2f ms\n", t1 - t0);
+    printf("GridIndex    : %9.2f ms (build %.2f ms, search %.2f ms), %.1fx, %d mismatches\n",
+           t3 - t1, t2 - t1, t3 - t2, (t1 - t0) / (t3 - t1), ix_mismatches);
+    printf("Aho-Corasick : %9.2f ms (build %.2f ms, sweep %.2f ms), %.1fx, %d mismatches\n",
+           t5 - t3, t4 - t3, t5 - t4, (t1 - t0) / (t5 - t3), ac_mismatches);
+    printf("All matches  : %9.2f ms, %d occurrences, %d words found more than once,"
+           " %d cells covered, %d mismatches\n",
+           t6 - t5, nb_all, repeated, nb_covered, all_mismatches);
+
+out:
+    free(hit);
+    free(first);
+    free(ref);
+    free(list);
+    free(words);
+    grid_free(&grille);
+}
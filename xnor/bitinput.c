@@ -0,0 +1,64 @@
+#include "bitinput.h"
+#include "kernels.h"
+
+void bits_from_pixels(const unsigned char *gray, BitInput *out) {
+    memset(out->bits, 0, sizeof(out->bits));
+    for (int i = 0; i < NUM_INPUTS; i++)
+        if (gray[i] < 200) out->bits[i >> 6] |= (uint64_t)1 << (i & 63);
+}
+
+void bits_from_inputs(const double *inputs, BitInput *out) {
+    memset(out->bits, 0, sizeof(out->bits));
+    for (int i = 0; i < NUM_INPUTS; i++)
+        if (inputs[i] != 0.0) out->bits[i >> 6] |= (uint64_t)1 << (i & 63);
+}
+
+// Like predict_batch: a tile of samples shares each weight row, visited once
+// for the union of their set bits.
+void predict_bits_batch(const NeuralNetwork *net, const BitInput *in, int n,
+                        char *letters, double *confidences) {
+    const DenseKernels *kern = kernels_get();
+    double hidden[BATCH_TILE][HIDDEN_STRIDE];
+    double out[BATCH_TILE][NUM_OUTPUTS];
+
+    for (int s0 = 0; s0 < n; s0 += BATCH_TILE) {
+        int nb = (n - s0 < BATCH_TILE) ? n - s0 : BATCH_TILE;
+        const BitInput *x = in + s0;
+
+        for (int s = 0; s < nb; s++)
+            for (int j = 0; j < NUM_HIDDEN; j++) hidden[s][j] = net->biases_h[j];
+
+        for (int w = 0; w < BIT_WORDS; w++) {
+            uint64_t any = 0;
+            for (int s = 0; s < nb; s++) any |= x[s].bits[w];
+            while (any) {
+                int b = __builtin_ctzll(any);
+                any &= any - 1;
+                const double *row = net->weights_ih[(w << 6) + b];
+                for (int s = 0; s < nb; s++)
+                    if ((x[s].bits[w] >> b) & 1)
+                        kern->axpy(NUM_HIDDEN, 1.0, row, hidden[s]);
+            }
+        }
+
+        for (int s = 0; s < nb; s++) {
+            for (int j = 0; j < NUM_HIDDEN; j++) hidden[s][j] = sigmoid(hidden[s][j]);
+            for (int j = 0; j < NUM_OUTPUTS; j++) out[s][j] = net->biases_o[j];
+        }
+
+        for (int k = 0; k < NUM_HIDDEN; k++) {
+            const double *row = net->weights_ho[k];
+            for (int s = 0; s < nb; s++)
+                kern->axpy(NUM_OUTPUTS, hidden[s][k], row, out[s]);
+        }
+
+        for (int s = 0; s < nb; s++) {
+            softmax(out[s], NUM_OUTPUTS);
+            int best = 0;
+            for (int j = 1; j < NUM_OUTPUTS; j++)
+                if (out[s][j] > out[s][best]) best = j;
+            letters[s0 + s] = (char)('A' + best);
+            if (confidences) confidences[s0 + s] = out[s][best] * 100.0;
+        }
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef BITINPUT_H
+#define BITINPUT_H
+
+#include <stdint.h>
+#include "networks.h"
+
+// One 48x48 glyph as a 2304-bit ink mask (bit k set <=> input k == 1.0)
+#define BIT_WORDS ((NUM_INPUTS + 63) / 64)
+
+typedef struct {
+    uint64_t bits[BIT_WORDS];
+} BitInput;
+
+// gray: IMAGE_WIDTH x IMAGE_HEIGHT tile, same threshold as preprocess_pixels
+void bits_from_pixels(const unsigned char *gray, BitInput *out);
+// inputs: NUM_INPUTS values that are exactly 0.0 or 1.0
+void bits_from_inputs(const double *inputs, BitInput *out);
+
+// First layer without multiplies: biases_h plus the weight rows of set bits.
+// Same results as predict_batch on the unpacked inputs
+void predict_bits_batch(const NeuralNetwork *net, const BitInput *in, int n,
+                        char *letters, double *confidences);
+
+#endif